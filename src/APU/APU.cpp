@@ -11,37 +11,154 @@ extern struct gb_global_t gb_global;
 */
 APU::APU(std::string name, uint16_t init_addr) : Bus_obj(name, init_addr, APU_REG_N){
 
-  // Init SDL APU
+  // Create waveforms for channels 1 and 2
+  _wave_duty_table.push_back({0, 0, 0, 0, 0, 0, 0, 1}); // 12.5 %
+  _wave_duty_table.push_back({0, 0, 0, 0, 0, 0, 1, 1}); // 25.0 %
+  _wave_duty_table.push_back({0, 0, 0, 0, 1, 1, 1, 1}); // 50.0 %
+  _wave_duty_table.push_back({1, 1, 1, 1, 1, 1, 0, 0}); // 75.0 %
+
+  // Reset registers
+  reset_registers();
+
+  // The APU is run lazily by the bus
+  this->catch_up = true;
+
+  // Nothing was sent to the output yet
+  _audio_ring = nullptr;
+  _audio_consumed = nullptr;
+  _audio_target = 0;
+  _audio_sample_rate = 0;
+  _audio_fill = 0;
+  _audio_block_samples = 0;
+  _audio_started = false;
+  _audio_last[0] = 0;
+  _audio_last[1] = 0;
+  _blip_left = nullptr;
+  _blip_right = nullptr;
+  _blip_time = 0;
+  _registers_only = true;
+  _audio_capture = nullptr;
+  for(int i = 0; i < APU_CHANNELS; i++){
+    _channel_level_left[i] = 0;
+    _channel_level_right[i] = 0;
+    _stem_capture[i] = nullptr;
+    _stem_left[i] = nullptr;
+    _stem_right[i] = nullptr;
+  }
+
+  // No audio device is opened in headless mode. Audio is also muted when the
+  // emulation is not paced at real time, either uncapped or at a different speed
+  if(gb_global.headless or !gb_global.fixed_fps or gb_global.speed != 1) return;
+
+  // Without audio device the emulation goes on silently, as in headless mode
   if(SDL_Init(SDL_INIT_AUDIO) != 0){
-    std::runtime_error("APU: SDL_Init failed");
+    std::cerr << "Audio not available, running without sound: " << SDL_GetError() << std::endl;
+    return;
   }
 
+  SDL_AudioSpec obtained;
+
+  // The device requires at most half the latency at each callback, so that
+  // the ring never runs empty while waiting for the next one
+  uint32_t callback_frames = APU_MAX_CALLBACK_FRAMES;
+  while(callback_frames > APU_MIN_CALLBACK_FRAMES and callback_frames * 2000 > gb_global.sample_rate * gb_global.audio_latency)
+    callback_frames /= 2;
+
   SDL_zero(audio_spec);
-  audio_spec.freq = APU_DSP_FREQUENCY;        // DSP frequency (sample per seconds)
+  audio_spec.freq = gb_global.sample_rate;    // DSP frequency (sample per seconds)
   audio_spec.format = AUDIO_S16SYS;           // Native 16-bits data in native order
   audio_spec.channels = 2;                    // Left and right channel
-  audio_spec.samples = APU_AUDIO_BUFFER_SIZE; // Audio buffer size in sample
-  audio_spec.callback = nullptr;              // No callback function
+  audio_spec.samples = callback_frames;       // Audio buffer size in sample
+  audio_spec.callback = audio_callback;       // Takes the samples from the ring
+  audio_spec.userdata = this;
 
   audio_device = SDL_OpenAudioDevice(
     NULL,         // Use most-reasonable default device
     0,            // Use for playback, not recording
     &audio_spec,  // Desired output format as specified above
-    NULL,         // Actual output format (?)
-    0             // Allowed changes
+    &obtained,    // Actual output format
+    SDL_AUDIO_ALLOW_FREQUENCY_CHANGE // The device might not support the requested frequency
   );
 
+  // No callback would ever drain the ring: the APU stays in registers only mode
+  if(audio_device == 0){
+    std::cerr << "Audio device not opened, running without sound: " << SDL_GetError() << std::endl;
+    SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    return;
+  }
+
+  // The samples are generated at the frequency of the device
+  enable_synthesis(obtained.freq);
+
+  // The resampling ratio is adjusted to keep the ring around the latency. The ring is at
+  // least twice as large, so that it only gets full if the callback stops
+  _audio_target = (uint32_t) ((uint64_t) obtained.freq * gb_global.audio_latency / 1000) * 2;
+  _audio_fill = _audio_target;
+  _audio_ring = new Audio_ring(_audio_target * 2 + APU_AUDIO_BUFFER_SIZE);
+  _audio_consumed = SDL_CreateSemaphore(0);
+
   // unpausing the audio device (starts playing):
   SDL_PauseAudioDevice(audio_device, 0);
+}
 
-  // Create waveforms for channels 1 and 2
-  _wave_duty_table.push_back({0, 0, 0, 0, 0, 0, 0, 1}); // 12.5 %
-  _wave_duty_table.push_back({0, 0, 0, 0, 0, 0, 1, 1}); // 25.0 %
-  _wave_duty_table.push_back({0, 0, 0, 0, 1, 1, 1, 1}); // 50.0 %
-  _wave_duty_table.push_back({1, 1, 1, 1, 1, 1, 0, 0}); // 75.0 %
+/** APU::enable_synthesis
+    Create the band-limited buffers of the output, if not done yet. From now
+    on the waveforms of the channels are generated
 
-  // Reset registers
-  reset_registers();
+    @param sample_rate uint32_t samples per second of the output
+
+*/
+void APU::enable_synthesis(uint32_t sample_rate){
+
+  if(!_registers_only) return;
+
+  _blip_left  = new Blip_buffer(APU_BUS_FREQUENCY, sample_rate, sample_rate / APU_BLIP_CAPACITY_DIVIDER, APU_MIX_SHIFT);
+  _blip_right = new Blip_buffer(APU_BUS_FREQUENCY, sample_rate, sample_rate / APU_BLIP_CAPACITY_DIVIDER, APU_MIX_SHIFT);
+  _audio_sample_rate = sample_rate;
+  _registers_only = false;
+}
+
+/** APU::get_sample_rate
+    @return uint32_t samples per second of the output: the one of the audio
+                     device if opened, the requested one otherwise
+
+*/
+uint32_t APU::get_sample_rate(){
+  return _registers_only ? gb_global.sample_rate : _audio_sample_rate;
+}
+
+/** APU::set_audio_capture
+    Send a copy of the stereo output to a capture file. The output is generated
+    even without audio device
+
+    @param capture Audio_capture* capture file, with the sample rate of the output
+
+*/
+void APU::set_audio_capture(Audio_capture* capture){
+  enable_synthesis(get_sample_rate());
+  _audio_capture = capture;
+}
+
+/** APU::set_stem_capture
+    Send the stereo output of a single channel to a capture file. The levels are
+    the same contributions the channel has in the mix
+
+    @param channel uint8_t index of the channel, from 0 to 3
+    @param capture Audio_capture* capture file, with the sample rate of the output
+
+*/
+void APU::set_stem_capture(uint8_t channel, Audio_capture* capture){
+
+  if(channel >= APU_CHANNELS) throw std::invalid_argument("APU: invalid channel for the stem capture");
+
+  enable_synthesis(get_sample_rate());
+
+  uint32_t sample_rate = get_sample_rate();
+  if(_stem_left[channel] == nullptr){
+    _stem_left[channel]  = new Blip_buffer(APU_BUS_FREQUENCY, sample_rate, sample_rate / APU_BLIP_CAPACITY_DIVIDER, APU_MIX_SHIFT);
+    _stem_right[channel] = new Blip_buffer(APU_BUS_FREQUENCY, sample_rate, sample_rate / APU_BLIP_CAPACITY_DIVIDER, APU_MIX_SHIFT);
+  }
+  _stem_capture[channel] = capture;
 }
 
 /** APU::read
@@ -58,67 +175,67 @@ uint8_t APU::read(uint16_t addr){
     res = WPRAM[addr - APU_WPRAM_INIT_ADDR];
   }
   else if(addr == APU_NR10_ADDR){
-    res = NR10 | 0x80;
+    res = NR10 | APU_NR10_READ_MASK;
   }
   else if(addr == APU_NR11_ADDR){
-    res = NR11 | 0x3F;
+    res = NR11 | APU_NR11_READ_MASK;
   }
   else if(addr == APU_NR12_ADDR){
-    res = NR12 | 0x00;
+    res = NR12 | APU_NR12_READ_MASK;
   }
   else if(addr == APU_NR13_ADDR){
-    res = NR13 | 0xFF;
+    res = NR13 | APU_NR13_READ_MASK;
   }
   else if(addr == APU_NR14_ADDR){
-    res = NR14 | 0xBF;
+    res = NR14 | APU_NR14_READ_MASK;
   }
   else if(addr == APU_NR21_ADDR){
-    res = NR21 | 0x3F;
+    res = NR21 | APU_NR21_READ_MASK;
   }
   else if(addr == APU_NR22_ADDR){
-    res = NR22 | 0x00;
+    res = NR22 | APU_NR22_READ_MASK;
   }
   else if(addr == APU_NR23_ADDR){
-    res = NR23 | 0xFF;
+    res = NR23 | APU_NR23_READ_MASK;
   }
   else if(addr == APU_NR24_ADDR){
-    res = NR24 | 0xBF;
+    res = NR24 | APU_NR24_READ_MASK;
   }
   else if(addr == APU_NR30_ADDR){
-    res = NR30 | 0x7F;
+    res = NR30 | APU_NR30_READ_MASK;
   }
   else if(addr == APU_NR31_ADDR){
-    res = NR31 | 0xFF;
+    res = NR31 | APU_NR31_READ_MASK;
   }
   else if(addr == APU_NR32_ADDR){
-    res = NR32 | 0x9F;
+    res = NR32 | APU_NR32_READ_MASK;
   }
   else if(addr == APU_NR33_ADDR){
-    res = NR33 | 0xFF;
+    res = NR33 | APU_NR33_READ_MASK;
   }
   else if(addr == APU_NR34_ADDR){
-    res = NR34 | 0xBF;
+    res = NR34 | APU_NR34_READ_MASK;
   }
   else if(addr == APU_NR41_ADDR){
-    res = NR41 | 0xFF;
+    res = NR41 | APU_NR41_READ_MASK;
   }
   else if(addr == APU_NR42_ADDR){
-    res = NR42 | 0x00;
+    res = NR42 | APU_NR42_READ_MASK;
   }
   else if(addr == APU_NR43_ADDR){
-    res = NR43 | 0x00;
+    res = NR43 | APU_NR43_READ_MASK;
   }
   else if(addr == APU_NR44_ADDR){
-    res = NR44 | 0xBF;
+    res = NR44 | APU_NR44_READ_MASK;
   }
   else if(addr == APU_NR50_ADDR){
-    res = NR50;
+    res = NR50 | APU_NR50_READ_MASK;
   }
   else if(addr == APU_NR51_ADDR){
-    res = NR51;
+    res = NR51 | APU_NR51_READ_MASK;
   }
   else if(addr == APU_NR52_ADDR){
-    res = NR52 | 0x70;
+    res = NR52 | APU_NR52_READ_MASK;
   }
   else{
     res = 0xFF;
@@ -127,6 +244,38 @@ uint8_t APU::read(uint16_t addr){
   return res;
 }
 
+/** APU::set_io_handlers
+    Let the bus read the registers directly through the IO table, together
+    with the bits which are always read as 1. Writes still go through `write`,
+    as they depend on the status of the APU. The APU must be connected to the bus
+
+    @param bus Bus* bus the APU is connected to
+
+*/
+void APU::set_io_handlers(Bus* bus){
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR10_ADDR, io_read_register<APU, &APU::NR10>, nullptr, APU_NR10_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR11_ADDR, io_read_register<APU, &APU::NR11>, nullptr, APU_NR11_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR12_ADDR, io_read_register<APU, &APU::NR12>, nullptr, APU_NR12_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR13_ADDR, io_read_register<APU, &APU::NR13>, nullptr, APU_NR13_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR14_ADDR, io_read_register<APU, &APU::NR14>, nullptr, APU_NR14_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR21_ADDR, io_read_register<APU, &APU::NR21>, nullptr, APU_NR21_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR22_ADDR, io_read_register<APU, &APU::NR22>, nullptr, APU_NR22_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR23_ADDR, io_read_register<APU, &APU::NR23>, nullptr, APU_NR23_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR24_ADDR, io_read_register<APU, &APU::NR24>, nullptr, APU_NR24_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR30_ADDR, io_read_register<APU, &APU::NR30>, nullptr, APU_NR30_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR31_ADDR, io_read_register<APU, &APU::NR31>, nullptr, APU_NR31_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR32_ADDR, io_read_register<APU, &APU::NR32>, nullptr, APU_NR32_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR33_ADDR, io_read_register<APU, &APU::NR33>, nullptr, APU_NR33_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR34_ADDR, io_read_register<APU, &APU::NR34>, nullptr, APU_NR34_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR41_ADDR, io_read_register<APU, &APU::NR41>, nullptr, APU_NR41_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR42_ADDR, io_read_register<APU, &APU::NR42>, nullptr, APU_NR42_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR43_ADDR, io_read_register<APU, &APU::NR43>, nullptr, APU_NR43_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR44_ADDR, io_read_register<APU, &APU::NR44>, nullptr, APU_NR44_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR50_ADDR, io_read_register<APU, &APU::NR50>, nullptr, APU_NR50_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR51_ADDR, io_read_register<APU, &APU::NR51>, nullptr, APU_NR51_READ_MASK);
+  bus->set_io_handler(MMU_APU_INIT_ADDR + APU_NR52_ADDR, io_read_register<APU, &APU::NR52>, nullptr, APU_NR52_READ_MASK);
+}
+
 /** write::write
     Write a byte in APU at a given address
 
@@ -295,6 +444,63 @@ void APU::write(uint16_t addr, uint8_t data){
   else{
     std::invalid_argument("Incorrect address for APU\n");
   }
+
+  // Triggers and DAC changes are visible in NR52 without waiting for a run
+  update_NR52();
+}
+
+/** cycles_to_reload
+    Number of T-cycles before a channel timer is reloaded. As in the 16-bit
+    counters of the channels, a value of zero lasts 65536 T-cycles.
+
+    @param timer uint16_t current value of the timer
+    @return uint32_t number of T-cycles
+
+*/
+static inline uint32_t cycles_to_reload(uint16_t timer){
+  return (timer == 0) ? 0x10000 : timer;
+}
+
+/** timer_period
+    Reload value of a channel timer, which is stored on 16 bits
+
+    @param period uint32_t period of the channel
+    @return uint32_t number of T-cycles between two reloads
+
+*/
+static inline uint32_t timer_period(uint32_t period){
+  period &= 0xffff;
+  return (period == 0) ? 0x10000 : period;
+}
+
+/** advance_timer
+    Advance a channel timer by several T-cycles at once. At each T-cycle the timer
+    is decremented, and it is reloaded with its period once it reaches zero. As in
+    the 16-bit counters of the channels, a value of zero lasts 65536 T-cycles.
+
+    @param timer uint16_t& timer to advance
+    @param period uint32_t reload value of the timer
+    @param cycles uint32_t number of T-cycles
+    @return uint32_t number of times the timer was reloaded
+
+*/
+static uint32_t advance_timer(uint16_t& timer, uint32_t period, uint32_t cycles){
+
+  uint32_t to_reload = cycles_to_reload(timer);
+  uint32_t reloads;
+
+  if(cycles < to_reload){
+    timer -= cycles;
+    return 0;
+  }
+
+  period = timer_period(period);
+
+  cycles -= to_reload;
+  reloads = 1 + cycles / period;
+  timer = period - cycles % period;
+
+  return reloads;
 }
 
 /** APU::step
@@ -304,98 +510,63 @@ void APU::write(uint16_t addr, uint8_t data){
 
 */
 void APU::step(Bus_obj* bus){
+  run(bus, 1);
+}
 
-  uint16_t channel_1_output = 0;
-  uint16_t channel_2_output = 0;
-  uint16_t channel_3_output = 0;
-  uint16_t channel_4_output = 0;
-  uint16_t apu_sample_left  = 0;
-  uint16_t apu_sample_right = 0;
-  uint8_t  apu_left_volume  = (NR50 >> 4) & 0x07;
-  uint8_t  apu_right_volume = (NR50     ) & 0x07;
-
-  // If APU is disabled, skip the computation of current samples and provide
-  // 0 as values. The audio cannot be skipped in order to mantain stable the framerate
-  if((NR52 & 0x80) != 0){
-
-    // Frame sequencer handler using timer DIV register
-    _current_DIV_value = bus->read(MMU_TIMER_INIT_ADDR);
-
-    // Compute steps of sweep, envelope and length functions, with resepct to a
-    // falling edge of one bit of DIV.
-    // -> Envlope is updated with 1/8 of frequency
-    // -> Length  is updated with 1/2 of frequency
-    // -> Sweep   is updated with 1/4 of frequency
-    _envelope_step = 0;
-    _sweep_step = 0;
-    _length_step = 0;
-
-    // Different bits are to be checked from the DIV register in case we are in single speed mode or in
-    // double speed mode. Though the behaviour is the same: once the bit has a falling edge, the
-    // frame_sequencer performs a step.
-    if(
-      (gb_global.double_speed == 0 and (_previous_DIV_value & (1 << 5)) and !(_current_DIV_value & (1 << 5)))
-      or
-      (gb_global.double_speed == 1 and (_previous_DIV_value & (1 << 6)) and !(_current_DIV_value & (1 << 6)))
-    ){
-      _frame_sequencer++;
-      _length_step   = ((_frame_sequencer % 2) == 0) ? 1 : 0;
-      _sweep_step    = ((_frame_sequencer % 4) == 0) ? 1 : 0;
-      _envelope_step = ((_frame_sequencer % 8) == 0) ? 1 : 0;
-    }
+/** APU::run
+    Perform several T-cycles of the APU at once. The timers of the channels are
+    advanced in bulk. When audio is enabled, each change of a channel output is
+    sent to the band-limited buffers at the cycle it happens, and the buffers
+    produce the samples for the speaker. Otherwise, nothing is done, since the
+    registers only change on writes and on the steps of the frame sequencer,
+    which are notified by the timer. Since the bus runs the APU before any
+    access to its registers, register writes take effect on the correct cycle.
 
-    // Store previous DIV value for next iteration
-    _previous_DIV_value = _current_DIV_value;
+    @param Bus_obj* unused, the APU does not access the bus
+    @param cycles uint32_t number of T-cycles to perform
 
-    // Get channels outputs
-    channel_1_output = channel_1_handler();
-    channel_2_output = channel_2_handler();
-    channel_3_output = channel_3_handler();
-    channel_4_output = channel_4_handler();
+*/
+void APU::run(Bus_obj*, uint32_t cycles){
 
-    // Sound panning left with volume
-    apu_sample_left =  ((NR51 & 0x80) ? channel_4_output / 4 : 0) +
-                       ((NR51 & 0x40) ? channel_3_output / 4 : 0) +
-                       ((NR51 & 0x20) ? channel_2_output / 4 : 0) +
-                       ((NR51 & 0x10) ? channel_1_output / 4 : 0) ;
+  uint16_t channel_output[APU_CHANNELS] = {0, 0, 0, 0};
 
-    apu_sample_left = apu_sample_left * (apu_left_volume + 1) / 8;
+  // If APU is disabled, channels are not advanced and their output is 0.
+  // The audio cannot be skipped in order to mantain stable the framerate
+  bool apu_enabled = (NR52 & 0x80) != 0;
 
-    // Sound panning right with volume
-    apu_sample_right =  ((NR51 & 0x08) ? channel_4_output / 4 : 0) +
-                        ((NR51 & 0x04) ? channel_3_output / 4 : 0) +
-                        ((NR51 & 0x02) ? channel_2_output / 4 : 0) +
-                        ((NR51 & 0x01) ? channel_1_output / 4 : 0) ;
+  // Without audio device, length, sweep, envelope and NR52 are the only state to
+  // keep: they change only on writes and on the steps of the frame sequencer
+  if(_registers_only) return;
 
-    apu_sample_right = apu_sample_right * (apu_right_volume + 1) / 8;
+  // Registers written since the last run (volume, panning, triggers...) change the outputs now
+  if(apu_enabled){
+    channel_output[0] = channel_1_handler(0);
+    channel_output[1] = channel_2_handler(0);
+    channel_output[2] = channel_3_handler(0);
+    channel_output[3] = channel_4_handler(0);
   }
+  for(int i = 0; i < APU_CHANNELS; i++) set_channel_output(i, channel_output[i], 0);
 
-  // Downsampling: use one sample each APU_BUS_FREQUENCY / APU_DSP_FREQUENCY
-  _audio_buffer_downsampling_counter += APU_DSP_FREQUENCY;
+  if(apu_enabled){
+    channel_output[0] = channel_1_handler(cycles);
+    channel_output[1] = channel_2_handler(cycles);
+    channel_output[2] = channel_3_handler(cycles);
+    channel_output[3] = channel_4_handler(cycles);
+  }
 
-  // Skip the audio phase in case no fixed fps are required. In this case, the audio system goes on
-  // as usual, but no samples are sent to the speaker and no delay is executed.
-  if(_audio_buffer_downsampling_counter > APU_BUS_FREQUENCY and gb_global.fixed_fps == 1){
-    _audio_buffer_downsampling_counter -= APU_BUS_FREQUENCY;
+  // Changes of volume and enabled channels at the end of the block
+  for(int i = 0; i < APU_CHANNELS; i++) set_channel_output(i, channel_output[i], cycles);
 
-    // Store samples in the buffer using LR order. In this phase, we take into account the volume amplification
-    // as set by the user, together with the amplitude scaling factor. Since the samples are on 16 bits, the
-    // value should not be higher than 2**16 - 1
-    _audio_buffer[_audio_buffer_counter++] = apu_sample_left  * gb_global.volume_amplification * APU_AMPLITUDE_SCALING;
-    _audio_buffer[_audio_buffer_counter++] = apu_sample_right * gb_global.volume_amplification * APU_AMPLITUDE_SCALING;
+  _blip_time += cycles;
 
-    // When the buffer is full, send the samples to the speaker functino
-    if(_audio_buffer_counter == APU_AUDIO_BUFFER_SIZE){
-      _audio_buffer_counter = 0;
+  send_samples();
+}
 
-      // Audio sync: This allows the audio to be synchronized with the screen, by
-      // running at almost 60 FPS
-      while ((SDL_GetQueuedAudioSize(audio_device)) > APU_AUDIO_BUFFER_SIZE * 2) SDL_Delay(1);
-      SDL_QueueAudio(audio_device, _audio_buffer, APU_AUDIO_BUFFER_SIZE * 2);
-    }
-  }
+/** APU::update_NR52
+    Adjust NR52 according to which channels are working
 
-  // Adjust NR52 according to which channels are working
+*/
+void APU::update_NR52(){
   if(_channel_1_is_enabled) NR52 |= 0b00000001;
   else                      NR52 &= 0b11111110;
   if(_channel_2_is_enabled) NR52 |= 0b00000010;
@@ -406,7 +577,247 @@ void APU::step(Bus_obj* bus){
   else                                                 NR52 &= 0b11111011;
   if(_channel_4_is_enabled) NR52 |= 0b00001000;
   else                      NR52 &= 0b11110111;
+}
 
+/** APU::get_cycles_to_event
+    The APU has no effect on the rest of the system, so it is only run when it
+    is accessed, at the steps of the frame sequencer, or when too many cycles
+    are pending. Without synthesis, the pending cycles have no effect at all
+
+    @return uint32_t number of T-cycles before the next run
+
+*/
+uint32_t APU::get_cycles_to_event(){
+  if(_registers_only) return UINT32_MAX;
+  return APU_MAX_RUN_CYCLES;
+}
+
+/** APU::set_channel_output
+    Update the output of a channel, sending the changes of the left and right levels to
+    the band-limited buffers. Levels take into account panning (NR51), master volume
+    (NR50) and the volume amplification set by the user.
+
+    @param channel uint8_t index of the channel, from 0 to 3
+    @param output uint16_t output of the channel, in the range [0, 15]
+    @param time uint32_t T-cycles from the beginning of the current block
+
+*/
+void APU::set_channel_output(uint8_t channel, uint16_t output, uint32_t time){
+
+  int32_t amplification = gb_global.volume_amplification * APU_AMPLITUDE_SCALING;
+  int32_t left_volume   = (NR51 & (0x10 << channel)) ? ((NR50 >> 4) & 0x07) + 1 : 0;
+  int32_t right_volume  = (NR51 & (0x01 << channel)) ? ((NR50     ) & 0x07) + 1 : 0;
+  int32_t level_left    = output * left_volume  * amplification;
+  int32_t level_right   = output * right_volume * amplification;
+
+  if(level_left != _channel_level_left[channel]){
+    _blip_left->add_delta(_blip_time + time, level_left - _channel_level_left[channel]);
+    if(_stem_left[channel]) _stem_left[channel]->add_delta(_blip_time + time, level_left - _channel_level_left[channel]);
+    _channel_level_left[channel] = level_left;
+  }
+
+  if(level_right != _channel_level_right[channel]){
+    _blip_right->add_delta(_blip_time + time, level_right - _channel_level_right[channel]);
+    if(_stem_right[channel]) _stem_right[channel]->add_delta(_blip_time + time, level_right - _channel_level_right[channel]);
+    _channel_level_right[channel] = level_right;
+  }
+}
+
+/** APU::send_samples
+    Move the complete samples from the band-limited buffers to the ring read by the
+    audio callback, and to the capture files
+
+*/
+void APU::send_samples(){
+
+  uint32_t available;
+  uint32_t to_read;
+  uint32_t pushed;
+  bool     new_block = false;
+
+  _blip_left->end_frame(_blip_time);
+  _blip_right->end_frame(_blip_time);
+  for(int i = 0; i < APU_CHANNELS; i++){
+    if(_stem_left[i] == nullptr) continue;
+    _stem_left[i]->end_frame(_blip_time);
+    _stem_right[i]->end_frame(_blip_time);
+  }
+  _blip_time = 0;
+
+  while((available = _blip_left->samples_available()) != 0){
+
+    // Samples are stored in LR order
+    to_read = APU_AUDIO_BUFFER_SIZE / 2;
+    if(to_read > available) to_read = available;
+
+    _blip_left->read_samples(&_audio_buffer[0], to_read, 2);
+    _blip_right->read_samples(&_audio_buffer[1], to_read, 2);
+
+    if(_audio_capture) _audio_capture->push_samples(_audio_buffer, to_read * 2);
+
+    if(_audio_ring == nullptr) continue;
+
+    // The ring is full only if the callback is late: wait for it to consume some samples. It
+    // signals the semaphore after each buffer, so no polling is required; if it does not
+    // run (device lost) the samples in excess are dropped after a timeout
+    while(_audio_ring->size() + to_read * 2 > _audio_ring->capacity()){
+      if(SDL_SemWaitTimeout(_audio_consumed, APU_AUDIO_TIMEOUT_MS) == SDL_MUTEX_TIMEDOUT) break;
+    }
+
+    pushed = _audio_ring->push(_audio_buffer, to_read * 2);
+    if(pushed != to_read * 2) _audio_ring->count_overrun();
+
+    // The fill of the ring changes by a whole buffer at each callback, thus it is averaged
+    // over the last blocks, sampling it at a fixed period of emulated time
+    _audio_block_samples += to_read;
+    while(_audio_block_samples >= APU_DRC_BLOCK_SAMPLES){
+      _audio_block_samples -= APU_DRC_BLOCK_SAMPLES;
+      _audio_fill += ((double) _audio_ring->size() - _audio_fill) / APU_DRC_SMOOTHING;
+      new_block = true;
+    }
+  }
+
+  // Stems are only captured
+  for(int i = 0; i < APU_CHANNELS; i++){
+    if(_stem_left[i] == nullptr) continue;
+
+    while((available = _stem_left[i]->samples_available()) != 0){
+      to_read = APU_AUDIO_BUFFER_SIZE / 2;
+      if(to_read > available) to_read = available;
+
+      _stem_left[i]->read_samples(&_audio_buffer[0], to_read, 2);
+      _stem_right[i]->read_samples(&_audio_buffer[1], to_read, 2);
+      _stem_capture[i]->push_samples(_audio_buffer, to_read * 2);
+    }
+  }
+
+  if(new_block) adjust_sample_rate();
+}
+
+/** APU::adjust_sample_rate
+    The emulation is paced by the clock, which never matches exactly the clock of the
+    audio device: dynamic rate control slightly changes the number of samples produced
+    per emulated second, so that the ring stays around the required latency. The
+    average fill is updated once per APU_DRC_BLOCK_SAMPLES sent to the ring, thus
+    independently of how often the APU is run
+
+*/
+void APU::adjust_sample_rate(){
+
+  // Produce more samples when the ring is below the target, less when above
+  double error = ((double) _audio_target - _audio_fill) / _audio_target;
+  if(error >  1) error =  1;
+  if(error < -1) error = -1;
+
+  uint32_t rate = (uint32_t) (_audio_sample_rate * (1 + APU_DRC_MAX_DEVIATION * error));
+  if(rate == _blip_left->get_sample_rate()) return;
+
+  // Stems must stay aligned with the mix
+  _blip_left->set_rates(APU_BUS_FREQUENCY, rate);
+  _blip_right->set_rates(APU_BUS_FREQUENCY, rate);
+  for(int i = 0; i < APU_CHANNELS; i++){
+    if(_stem_left[i] == nullptr) continue;
+    _stem_left[i]->set_rates(APU_BUS_FREQUENCY, rate);
+    _stem_right[i]->set_rates(APU_BUS_FREQUENCY, rate);
+  }
+}
+
+/** APU::audio_callback
+    Called by SDL from the audio thread each time the device requires some samples.
+    They are taken from the ring once it is filled up to the latency; in case they are
+    not enough, the last sample is repeated to avoid clicks, and the ring is filled
+    again before being used
+
+    @param userdata void* the APU which opened the device
+    @param stream Uint8* buffer to fill
+    @param len int size of the buffer in bytes
+
+*/
+void APU::audio_callback(void* userdata, Uint8* stream, int len){
+
+  APU*     apu     = (APU*) userdata;
+  int16_t* samples = (int16_t*) stream;
+  uint32_t count   = len / sizeof(int16_t);
+  uint32_t popped  = 0;
+
+  // The rate control can only keep the latency, not build it
+  if(!apu->_audio_started and apu->_audio_ring->size() >= apu->_audio_target)
+    apu->_audio_started = true;
+
+  if(apu->_audio_started){
+    popped = apu->_audio_ring->pop(samples, count);
+
+    if(popped < count){
+      apu->_audio_ring->count_underrun();
+      apu->_audio_started = false;
+    }
+  }
+
+  // Samples are always moved in LR pairs
+  if(popped != 0){
+    apu->_audio_last[0] = samples[popped - 2];
+    apu->_audio_last[1] = samples[popped - 1];
+  }
+
+  for(uint32_t i = popped; i < count; i++) samples[i] = apu->_audio_last[i & 1];
+
+  SDL_SemPost(apu->_audio_consumed);
+}
+
+/** APU::get_audio_underruns
+    @return uint32_t number of times the audio device required more samples than available
+
+*/
+uint32_t APU::get_audio_underruns(){
+  return _audio_ring ? _audio_ring->get_underruns() : 0;
+}
+
+/** APU::get_audio_overruns
+    @return uint32_t number of times some samples were dropped, since the device did not consume them
+
+*/
+uint32_t APU::get_audio_overruns(){
+  return _audio_ring ? _audio_ring->get_overruns() : 0;
+}
+
+/** APU::frame_sequencer_step
+    Perform a step of the frame sequencer. It is called by the timer on the
+    falling edge of the DIV bit driving the sequencer, once the APU was run up
+    to the current cycle
+
+*/
+void APU::frame_sequencer_step(){
+
+  uint16_t channel_output[APU_CHANNELS];
+
+  // The frame sequencer is stopped while the APU is off
+  if((NR52 & 0x80) == 0) return;
+
+  // Compute steps of sweep, envelope and length functions
+  // -> Envlope is updated with 1/8 of frequency
+  // -> Length  is updated with 1/2 of frequency
+  // -> Sweep   is updated with 1/4 of frequency
+  _frame_sequencer++;
+  _length_step   = ((_frame_sequencer % 2) == 0) ? 1 : 0;
+  _sweep_step    = ((_frame_sequencer % 4) == 0) ? 1 : 0;
+  _envelope_step = ((_frame_sequencer % 8) == 0) ? 1 : 0;
+
+  if(_length_step or _sweep_step or _envelope_step){
+    channel_output[0] = channel_1_handler(0);
+    channel_output[1] = channel_2_handler(0);
+    channel_output[2] = channel_3_handler(0);
+    channel_output[3] = channel_4_handler(0);
+
+    // New frequency, volume or disabled channels are heard from now on
+    if(!_registers_only)
+      for(int i = 0; i < APU_CHANNELS; i++) set_channel_output(i, channel_output[i], 0);
+
+    _envelope_step = 0;
+    _sweep_step = 0;
+    _length_step = 0;
+  }
+
+  update_NR52();
 }
 
 /** APU::~APU
@@ -414,18 +825,31 @@ void APU::step(Bus_obj* bus){
 
 */
 APU::~APU(){
+  delete _blip_left;
+  delete _blip_right;
+  for(int i = 0; i < APU_CHANNELS; i++){
+    delete _stem_left[i];
+    delete _stem_right[i];
+  }
+
+  if(_audio_ring == nullptr) return;
+
+  // The callback must be stopped before the ring is released
   SDL_CloseAudioDevice(audio_device);
+  SDL_DestroySemaphore(_audio_consumed);
+  delete _audio_ring;
   SDL_Quit();
 }
 
 /** APU::channel_1_handler
-    Handle the step for channel 1, generating the corresponding sample in the range
-    [0, 15 * APU_AMPLITUDE_SCALING]
+    Advance channel 1 by some T-cycles, generating the sample at the last one in the
+    range [0, 15 * APU_AMPLITUDE_SCALING]
 
+    @param cycles uint32_t number of T-cycles
     @return uint16_t sample from channel 1
 
 */
-uint16_t APU::channel_1_handler(){
+uint16_t APU::channel_1_handler(uint32_t cycles){
 
   // Duty cycle to use for the wave function
   uint8_t  duty_cycle     = (NR11 >> 6) & 0x03;
@@ -446,10 +870,20 @@ uint16_t APU::channel_1_handler(){
 
   if(!_channel_1_is_enabled) return 0;
 
-  // Reset period and step the element to use in the waveform
-  if(--_channel_1_timer == 0){
-    _channel_1_timer = (2048 - _channel_1_frequency) * 4;
-    _channel_1_wave_duty_position = (_channel_1_wave_duty_position + 1) % 8;
+  // Without audio output the waveform is not generated, as it is not visible from the registers
+  if(!_registers_only){
+
+    // Reset period and step the element to use in the waveform
+    uint32_t period = timer_period((2048 - _channel_1_frequency) * 4);
+    uint32_t first_reload = cycles_to_reload(_channel_1_timer);
+    uint32_t reloads = advance_timer(_channel_1_timer, period, cycles);
+
+    // Each step of the waveform is sent to the output when it happens
+    for(uint32_t i = 0; i < reloads; i++){
+      _channel_1_wave_duty_position = (_channel_1_wave_duty_position + 1) % 8;
+      amplitude = _wave_duty_table[duty_cycle][_channel_1_wave_duty_position];
+      set_channel_output(0, amplitude * _channel_1_volume, first_reload + i * period);
+    }
   }
 
   // Compute current amplitude for the channel
@@ -500,13 +934,14 @@ uint16_t APU::channel_1_handler(){
 }
 
 /** APU::channel_2_handler
-    Handle the step for channel 2, generating the corresponding sample in the range
-    [0, 15 * APU_AMPLITUDE_SCALING]
+    Advance channel 2 by some T-cycles, generating the sample at the last one in the
+    range [0, 15 * APU_AMPLITUDE_SCALING]
 
+    @param cycles uint32_t number of T-cycles
     @return uint16_t sample from channel 2
 
 */
-uint16_t APU::channel_2_handler(){
+uint16_t APU::channel_2_handler(uint32_t cycles){
 
   // Duty cycle to use for the wave function
   uint8_t  duty_cycle           = (NR21 >> 6) & 0x03;
@@ -523,10 +958,20 @@ uint16_t APU::channel_2_handler(){
 
   if(!_channel_2_is_enabled) return 0;
 
-  // Reset period and step the element to use in the waveform
-  if(--_channel_2_timer == 0){
-    _channel_2_timer = frequency_timer_init;
-    _channel_2_wave_duty_position = (_channel_2_wave_duty_position + 1) % 8;
+  // Without audio output the waveform is not generated, as it is not visible from the registers
+  if(!_registers_only){
+
+    // Reset period and step the element to use in the waveform
+    uint32_t period = timer_period(frequency_timer_init);
+    uint32_t first_reload = cycles_to_reload(_channel_2_timer);
+    uint32_t reloads = advance_timer(_channel_2_timer, period, cycles);
+
+    // Each step of the waveform is sent to the output when it happens
+    for(uint32_t i = 0; i < reloads; i++){
+      _channel_2_wave_duty_position = (_channel_2_wave_duty_position + 1) % 8;
+      amplitude = _wave_duty_table[duty_cycle][_channel_2_wave_duty_position];
+      set_channel_output(1, amplitude * _channel_2_volume, first_reload + i * period);
+    }
   }
 
   // Compute current amplitude for the channel
@@ -554,16 +999,15 @@ uint16_t APU::channel_2_handler(){
 }
 
 /** APU::channel_3_handler
-    Handle the step for channel 3, generating the corresponding sample in the range
-    [0, 15 * APU_AMPLITUDE_SCALING]
+    Advance channel 3 by some T-cycles, generating the sample at the last one in the
+    range [0, 15 * APU_AMPLITUDE_SCALING]
 
+    @param cycles uint32_t number of T-cycles
     @return uint16_t sample from channel 3
 
 */
-uint16_t APU::channel_3_handler(){
+uint16_t APU::channel_3_handler(uint32_t cycles){
 
-  // Current volume
-  uint8_t  output_level           = (NR32 >> 5) & 0x03;
   // Initial frequency to use (no sweep function in channel 3)
   uint16_t frequency              = NR33 | ((NR34 & 0x07) << 8);
   // Timer to use
@@ -573,23 +1017,22 @@ uint16_t APU::channel_3_handler(){
 
   if(!_channel_3_is_enabled) return 0;
 
-  // Reset period and step the element to use in the waveform
-  if(--_channel_3_timer == 0){
-    _channel_3_timer          = frequency_timer_init;
-    _channel_3_current_sample = (_channel_3_current_sample + 1) % 32;
-  }
+  // Without audio output the wave is not played, as it is not visible from the registers
+  if(!_registers_only){
 
-  // Compute current amplitude for the channel (for each sample, first
-  // use the upper nibble, then the lower one)
-  amplitude = WPRAM[_channel_3_current_sample / 2];
-  if(_channel_3_current_sample % 2 == 0) amplitude = (amplitude >> 4) & 0x0f;
-  else                                   amplitude =  amplitude       & 0x0f;
+    // Reset period and step the element to use in the waveform
+    uint32_t period = timer_period(frequency_timer_init);
+    uint32_t first_reload = cycles_to_reload(_channel_3_timer);
+    uint32_t reloads = advance_timer(_channel_3_timer, period, cycles);
 
-  // Modify the amplitude according to the output volume
-  amplitude = (output_level == 0b00) ? 0              :
-              (output_level == 0b01) ? amplitude      :
-              (output_level == 0b10) ? amplitude >> 1 :
-                                       amplitude >> 2 ;
+    // Each sample of the wave is sent to the output when it is reached
+    for(uint32_t i = 0; i < reloads; i++){
+      _channel_3_current_sample = (_channel_3_current_sample + 1) % 32;
+      set_channel_output(2, channel_3_get_amplitude() * _channel_3_dac_enabled, first_reload + i * period);
+    }
+  }
+
+  amplitude = channel_3_get_amplitude();
 
   // Stop timer when length timer expires
   if(_length_step and (NR34 & 0x40)){
@@ -602,14 +1045,39 @@ uint16_t APU::channel_3_handler(){
   return amplitude * _channel_3_dac_enabled;
 
 }
+
+/** APU::channel_3_get_amplitude
+    Amplitude of the current sample of the wave, according to the output level
+
+    @return uint16_t amplitude in the range [0, 15]
+
+*/
+uint16_t APU::channel_3_get_amplitude(){
+
+  // Current volume
+  uint8_t  output_level = (NR32 >> 5) & 0x03;
+
+  // Compute current amplitude for the channel (for each sample, first
+  // use the upper nibble, then the lower one)
+  uint16_t amplitude = WPRAM[_channel_3_current_sample / 2];
+  if(_channel_3_current_sample % 2 == 0) amplitude = (amplitude >> 4) & 0x0f;
+  else                                   amplitude =  amplitude       & 0x0f;
+
+  // Modify the amplitude according to the output volume
+  return (output_level == 0b00) ? 0              :
+         (output_level == 0b01) ? amplitude      :
+         (output_level == 0b10) ? amplitude >> 1 :
+                                  amplitude >> 2 ;
+}
 /** APU::channel_4_handler
-    Handle the step for channel 4, generating the corresponding sample in the range
-    [0, 15 * APU_AMPLITUDE_SCALING]
+    Advance channel 4 by some T-cycles, generating the sample at the last one in the
+    range [0, 15 * APU_AMPLITUDE_SCALING]
 
+    @param cycles uint32_t number of T-cycles
     @return uint16_t sample from channel 4
 
 */
-uint16_t APU::channel_4_handler(){
+uint16_t APU::channel_4_handler(uint32_t cycles){
 
   // Timer to use for the envelope function
   uint8_t  envelope_timer = NR42 & 0x07;
@@ -622,18 +1090,27 @@ uint16_t APU::channel_4_handler(){
 
   if(!_channel_4_is_enabled) return 0;
 
-  // Reset period and step the LSFR
-  if(--_channel_4_timer == 0){
-    _channel_4_timer = channel_4_get_period();
+  // Without audio output the noise is not generated, as it is not visible from the registers
+  if(!_registers_only){
+
+    // Reset period and step the LSFR, once for each reload of the timer
+    uint32_t period = timer_period(channel_4_get_period());
+    uint32_t first_reload = cycles_to_reload(_channel_4_timer);
+    uint32_t reloads = advance_timer(_channel_4_timer, period, cycles);
+    for(uint32_t i = 0; i < reloads; i++){
 
-    // Compute LSFR new bit and shift
-    xor_result = (~((_channel_4_LSFR & 1) ^ ((_channel_4_LSFR >> 1) & 1))) & 1;
-    _channel_4_LSFR = (_channel_4_LSFR >> 1) | (xor_result << 14);
+      // Compute LSFR new bit and shift
+      xor_result = (~((_channel_4_LSFR & 1) ^ ((_channel_4_LSFR >> 1) & 1))) & 1;
+      _channel_4_LSFR = (_channel_4_LSFR >> 1) | (xor_result << 14);
 
-    // Update bit 6 if small mode is enabled
-    if(NR43 & 0x04){
-      _channel_4_LSFR &= ~(1 << 6);
-      _channel_4_LSFR |= xor_result << 6;
+      // Update bit 6 if small mode is enabled
+      if(NR43 & 0x04){
+        _channel_4_LSFR &= ~(1 << 6);
+        _channel_4_LSFR |= xor_result << 6;
+      }
+
+      // Each new bit is sent to the output when it is generated
+      set_channel_output(3, (_channel_4_LSFR & 1) * _channel_4_volume, first_reload + i * period);
     }
   }
 
@@ -695,8 +1172,6 @@ void APU::reset_registers(){
   NR51 = 0xF3;
   NR52 = 0xF1;
 
-  _previous_DIV_value = 0;
-  _current_DIV_value = 0;
   _frame_sequencer = 0;
 
   _channel_1_is_enabled = 0;
@@ -730,10 +1205,7 @@ void APU::reset_registers(){
   _channel_4_volume = 0;
   _channel_4_LSFR = 0;
 
-  _audio_buffer_counter = 0;
-  _audio_buffer_downsampling_counter = 0;
-
-  memset((void*) _audio_buffer, 0, APU_AUDIO_BUFFER_SIZE * sizeof(uint16_t));
+  memset((void*) _audio_buffer, 0, APU_AUDIO_BUFFER_SIZE * sizeof(int16_t));
 }
 
 /** APU::channel_4_get_period
@@ -2,18 +2,45 @@
 #define __APU_H
 
 #include "../bus/bus_obj.h"
+#include "../bus/bus.h"
 #include "APU_def.h"
 #include <cstdint>
 #include <vector>
 #include <stdexcept>
 #include "../memory/memory_map.h"
 #include "../utils/gb_global_t.h"
+#include "blip_buffer.h"
+#include "audio_ring.h"
+#include "../utils/audio_capture.h"
 #include <SDL.h>
 
+// Samples moved at once from the band-limited buffers to the ring
 #define APU_AUDIO_BUFFER_SIZE 2400
-#define APU_DSP_FREQUENCY     48000
+// Range of the frames required by the audio device at each callback
+#define APU_MIN_CALLBACK_FRAMES 64
+#define APU_MAX_CALLBACK_FRAMES 2048
+// Maximum time spent waiting for the audio callback
+#define APU_AUDIO_TIMEOUT_MS  100
 #define APU_BUS_FREQUENCY     4800000
+// Maximum relative change of the sample rate due to dynamic rate control, which is
+// not audible. The fill of the ring is sampled once per block of stereo samples sent
+// to it, so at a fixed period of emulated time, and averaged on a number of blocks
+#define APU_DRC_MAX_DEVIATION 0.005
+#define APU_DRC_BLOCK_SAMPLES 256
+#define APU_DRC_SMOOTHING     64
 #define APU_AMPLITUDE_SCALING 100
+#define APU_CHANNELS          4
+
+// The levels sent to the band-limited buffers are the channel outputs multiplied by the
+// master volume (1 to 8) and the amplification; the sum of the 4 channels is divided by 32
+#define APU_MIX_SHIFT         5
+
+// The band-limited buffers can store 1 / APU_BLIP_CAPACITY_DIVIDER seconds of samples
+#define APU_BLIP_CAPACITY_DIVIDER 10
+
+// Maximum number of T-cycles the APU is late of while synthesizing, low enough to keep
+// the audio buffer fed regularly. The frame sequencer is driven by the timer instead
+#define APU_MAX_RUN_CYCLES    4096
 
 class APU : public Bus_obj {
 
@@ -54,13 +81,38 @@ class APU : public Bus_obj {
   uint8_t WPRAM[16];
 
   // APU Internal variables
-  uint16_t _audio_buffer[APU_AUDIO_BUFFER_SIZE];
-  uint16_t _audio_buffer_counter;
-  uint32_t _audio_buffer_downsampling_counter;
+  int16_t  _audio_buffer[APU_AUDIO_BUFFER_SIZE];
+
+  // Samples waiting for the audio callback, which signals the semaphore after each
+  // buffer. The ring is kept around _audio_target samples (the latency) by changing the
+  // sample rate according to the average fill. The callback only uses the ring
+  // once it reached the latency, and repeats the last samples until then
+  Audio_ring* _audio_ring;
+  SDL_sem*    _audio_consumed;
+  uint32_t    _audio_target;
+  uint32_t    _audio_sample_rate;
+  double      _audio_fill;
+  uint32_t    _audio_block_samples;
+  bool        _audio_started;
+  int16_t     _audio_last[2];
+
+  // Band-limited synthesis of the left and right outputs. Levels of each channel
+  // are kept to send only their changes; time is counted from the last samples sent
+  Blip_buffer* _blip_left;
+  Blip_buffer* _blip_right;
+  uint32_t     _blip_time;
+  int32_t      _channel_level_left[APU_CHANNELS];
+  int32_t      _channel_level_right[APU_CHANNELS];
+
+  // No audio output: waveforms are not generated, only the state visible from the registers is kept
+  bool         _registers_only;
+
+  // Optional capture of the output and of each channel, which have their own buffers
+  Audio_capture* _audio_capture;
+  Audio_capture* _stem_capture[APU_CHANNELS];
+  Blip_buffer*   _stem_left[APU_CHANNELS];
+  Blip_buffer*   _stem_right[APU_CHANNELS];
   std::vector<std::vector<uint8_t>> _wave_duty_table;
-  uint8_t _previous_DIV_value;
-  uint8_t _current_DIV_value;
-
   uint8_t _length_step;
   uint8_t _envelope_step;
   uint8_t _sweep_step;
@@ -105,10 +157,17 @@ class APU : public Bus_obj {
   SDL_AudioSpec audio_spec;
 
   // APU Internal functions
-  uint16_t channel_1_handler();
-  uint16_t channel_2_handler();
-  uint16_t channel_3_handler();
-  uint16_t channel_4_handler();
+  uint16_t channel_1_handler(uint32_t);
+  uint16_t channel_2_handler(uint32_t);
+  uint16_t channel_3_handler(uint32_t);
+  uint16_t channel_4_handler(uint32_t);
+  uint16_t channel_3_get_amplitude();
+  void     set_channel_output(uint8_t, uint16_t, uint32_t);
+  void     enable_synthesis(uint32_t);
+  void     send_samples();
+  void     adjust_sample_rate();
+  void     update_NR52();
+  static void audio_callback(void*, Uint8*, int);
   void     reset_registers();
   uint16_t channel_4_get_period();
 
@@ -118,6 +177,15 @@ public:
   uint8_t read(uint16_t);
   void    write(uint16_t, uint8_t);
   void    step(Bus_obj*);
+  void    run(Bus_obj*, uint32_t);
+  uint32_t get_cycles_to_event();
+  void     set_io_handlers(Bus*);
+  void     frame_sequencer_step();
+  uint32_t get_sample_rate();
+  void     set_audio_capture(Audio_capture*);
+  void     set_stem_capture(uint8_t, Audio_capture*);
+  uint32_t get_audio_underruns();
+  uint32_t get_audio_overruns();
   ~APU();
 
 };
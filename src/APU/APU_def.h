@@ -3,4 +3,27 @@
 
 #define APU_REG_N 0x30
 
+// Bits of the registers which are always read as 1
+#define APU_NR10_READ_MASK 0x80
+#define APU_NR11_READ_MASK 0x3F
+#define APU_NR12_READ_MASK 0x00
+#define APU_NR13_READ_MASK 0xFF
+#define APU_NR14_READ_MASK 0xBF
+#define APU_NR21_READ_MASK 0x3F
+#define APU_NR22_READ_MASK 0x00
+#define APU_NR23_READ_MASK 0xFF
+#define APU_NR24_READ_MASK 0xBF
+#define APU_NR30_READ_MASK 0x7F
+#define APU_NR31_READ_MASK 0xFF
+#define APU_NR32_READ_MASK 0x9F
+#define APU_NR33_READ_MASK 0xFF
+#define APU_NR34_READ_MASK 0xBF
+#define APU_NR41_READ_MASK 0xFF
+#define APU_NR42_READ_MASK 0x00
+#define APU_NR43_READ_MASK 0x00
+#define APU_NR44_READ_MASK 0xBF
+#define APU_NR50_READ_MASK 0x00
+#define APU_NR51_READ_MASK 0x00
+#define APU_NR52_READ_MASK 0x70
+
 #endif //__APU_DEF_H
@@ -0,0 +1,116 @@
+#include "audio_ring.h"
+#include <stdexcept>
+
+/** Audio_ring::Audio_ring
+    Constructor of the class
+
+    @param capacity uint32_t minimum number of samples the ring can store
+
+*/
+Audio_ring::Audio_ring(uint32_t capacity){
+
+  if(capacity == 0 or capacity > 0x80000000) throw std::invalid_argument("Audio_ring: invalid capacity");
+
+  uint32_t size = 1;
+  while(size < capacity) size <<= 1;
+
+  _samples.resize(size);
+  _mask = size - 1;
+  _read = 0;
+  _write = 0;
+  _underruns = 0;
+  _overruns = 0;
+}
+
+/** Audio_ring::push
+    Add samples to the ring. Only called by the producer
+
+    @param samples const int16_t* samples to add
+    @param count uint32_t number of samples
+    @return uint32_t number of samples added, limited by the free space
+
+*/
+uint32_t Audio_ring::push(const int16_t* samples, uint32_t count){
+
+  uint32_t write = _write.load(std::memory_order_relaxed);
+  uint32_t free  = _mask + 1 - (write - _read.load(std::memory_order_acquire));
+
+  if(count > free) count = free;
+
+  for(uint32_t i = 0; i < count; i++) _samples[(write + i) & _mask] = samples[i];
+
+  // Publish the samples only once they are stored
+  _write.store(write + count, std::memory_order_release);
+  return count;
+}
+
+/** Audio_ring::pop
+    Remove samples from the ring. Only called by the consumer
+
+    @param samples int16_t* destination of the samples
+    @param count uint32_t number of samples required
+    @return uint32_t number of samples removed, limited by the available ones
+
+*/
+uint32_t Audio_ring::pop(int16_t* samples, uint32_t count){
+
+  uint32_t read      = _read.load(std::memory_order_relaxed);
+  uint32_t available = _write.load(std::memory_order_acquire) - read;
+
+  if(count > available) count = available;
+
+  for(uint32_t i = 0; i < count; i++) samples[i] = _samples[(read + i) & _mask];
+
+  // The space is given back to the producer only once the samples are copied
+  _read.store(read + count, std::memory_order_release);
+  return count;
+}
+
+/** Audio_ring::size
+    @return uint32_t number of samples in the ring. It is exact only from the
+                     point of view of one side, as the other keeps working
+
+*/
+uint32_t Audio_ring::size(){
+  return _write.load(std::memory_order_acquire) - _read.load(std::memory_order_acquire);
+}
+
+/** Audio_ring::capacity
+    @return uint32_t maximum number of samples in the ring
+
+*/
+uint32_t Audio_ring::capacity(){
+  return _mask + 1;
+}
+
+/** Audio_ring::count_underrun
+    The consumer required more samples than available
+
+*/
+void Audio_ring::count_underrun(){
+  _underruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+/** Audio_ring::count_overrun
+    The producer dropped some samples since the ring was full
+
+*/
+void Audio_ring::count_overrun(){
+  _overruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+/** Audio_ring::get_underruns
+    @return uint32_t number of underruns since the creation of the ring
+
+*/
+uint32_t Audio_ring::get_underruns(){
+  return _underruns.load(std::memory_order_relaxed);
+}
+
+/** Audio_ring::get_overruns
+    @return uint32_t number of overruns since the creation of the ring
+
+*/
+uint32_t Audio_ring::get_overruns(){
+  return _overruns.load(std::memory_order_relaxed);
+}
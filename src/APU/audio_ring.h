@@ -0,0 +1,43 @@
+#ifndef __AUDIO_RING_H
+#define __AUDIO_RING_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Single-producer single-consumer ring of audio samples, used to move the
+ * samples from the emulation thread to the audio callback without locks.
+ * The read and write indices are free-running counters: each one is only
+ * modified by its own side, and the other side observes it through an
+ * acquire load. The capacity is rounded up to a power of two.
+ *
+ * The ring also counts underruns (the callback found fewer samples than
+ * required) and overruns (the producer had to drop samples).
+ * */
+class Audio_ring {
+
+  std::vector<int16_t>  _samples;
+  uint32_t              _mask;
+
+  // Total number of samples read and written
+  std::atomic<uint32_t> _read;
+  std::atomic<uint32_t> _write;
+
+  std::atomic<uint32_t> _underruns;
+  std::atomic<uint32_t> _overruns;
+
+public:
+
+  Audio_ring(uint32_t);
+  uint32_t push(const int16_t*, uint32_t);
+  uint32_t pop(int16_t*, uint32_t);
+  uint32_t size();
+  uint32_t capacity();
+  void     count_underrun();
+  void     count_overrun();
+  uint32_t get_underruns();
+  uint32_t get_overruns();
+};
+
+#endif // __AUDIO_RING_H
@@ -0,0 +1,187 @@
+#include "blip_buffer.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+/** Blip_buffer::Blip_buffer
+    Constructor of the class
+
+    @param clock_rate uint32_t clocks per second of the input
+    @param sample_rate uint32_t samples per second of the output
+    @param capacity uint32_t maximum number of output samples waiting to be read
+    @param amplitude_shift uint8_t the output is the integrated signal divided by 2^amplitude_shift
+
+*/
+Blip_buffer::Blip_buffer(uint32_t clock_rate, uint32_t sample_rate, uint32_t capacity, uint8_t amplitude_shift){
+
+  if(capacity == 0) throw std::invalid_argument("Blip_buffer: capacity must be positive");
+
+  _capacity = capacity;
+  _amplitude_shift = amplitude_shift;
+  _buffer.resize(capacity + BLIP_KERNEL_WIDTH);
+
+  set_rates(clock_rate, sample_rate);
+  build_kernel();
+  clear();
+}
+
+/** Blip_buffer::set_rates
+    Change the resampling ratio. This can be done between two blocks, for
+    instance to slightly adjust the speed of the output
+
+    @param clock_rate uint32_t clocks per second of the input
+    @param sample_rate uint32_t samples per second of the output
+
+*/
+void Blip_buffer::set_rates(uint32_t clock_rate, uint32_t sample_rate){
+
+  if(clock_rate == 0 or sample_rate == 0 or sample_rate > clock_rate)
+    throw std::invalid_argument("Blip_buffer: sample rate must be positive and lower than the clock rate");
+
+  _clock_rate = clock_rate;
+  _sample_rate = sample_rate;
+  _factor = ((uint64_t)sample_rate << BLIP_TIME_BITS) / clock_rate;
+}
+
+/** Blip_buffer::get_sample_rate
+    @return uint32_t samples per second of the output
+
+*/
+uint32_t Blip_buffer::get_sample_rate(){
+  return _sample_rate;
+}
+
+/** Blip_buffer::build_kernel
+    Compute the band-limited steps. Each one is the integral of a windowed sinc
+    (Blackman window), centered BLIP_KERNEL_WIDTH / 2 samples after the change,
+    sampled at the output rate and stored as differences between consecutive samples.
+    The coefficients of each phase sum exactly to 2^BLIP_KERNEL_BITS, so that a step
+    of amplitude `delta` always ends at `delta`.
+
+*/
+void Blip_buffer::build_kernel(){
+
+  const int    integration_steps = 64;
+  const double half_width = BLIP_KERNEL_WIDTH / 2.0;
+
+  // Impulse response of the band-limited step
+  auto impulse = [&](double t){
+    if(t <= -half_width or t >= half_width) return 0.0;
+    double x = M_PI * BLIP_CUTOFF * t;
+    double sinc = (x == 0.0) ? 1.0 : std::sin(x) / x;
+    double window = 0.42 + 0.5 * std::cos(M_PI * t / half_width) + 0.08 * std::cos(2 * M_PI * t / half_width);
+    return BLIP_CUTOFF * sinc * window;
+  };
+
+  for(int phase = 0; phase < BLIP_PHASES; phase++){
+
+    double fraction = (double)phase / BLIP_PHASES;
+    double previous = 0;
+    double step = 0;
+    int32_t sum = 0;
+    int32_t largest = 0;
+
+    // The step value at sample k is the integral of the impulse up to k - half_width - fraction
+    for(int k = 0; k < BLIP_KERNEL_WIDTH; k++){
+      double from = k - half_width - fraction;
+      double dt = 1.0 / integration_steps;
+
+      // Midpoint integration over one sample
+      for(int i = 0; i < integration_steps; i++) step += impulse(from + (i + 0.5) * dt) * dt;
+
+      _kernel[phase][k] = (int32_t)std::lround((step - previous) * (1 << BLIP_KERNEL_BITS));
+      previous = step;
+      sum += _kernel[phase][k];
+      if(std::abs(_kernel[phase][k]) > std::abs(_kernel[phase][largest])) largest = k;
+    }
+
+    // Rounding errors are moved in the largest coefficient
+    _kernel[phase][largest] += (1 << BLIP_KERNEL_BITS) - sum;
+  }
+}
+
+/** Blip_buffer::add_delta
+    Add a change of amplitude of the input signal
+
+    @param time uint32_t time of the change, in clocks from the beginning of the block
+    @param delta int32_t change of amplitude
+
+*/
+void Blip_buffer::add_delta(uint32_t time, int32_t delta){
+
+  uint64_t position = _offset + time * _factor;
+  uint32_t index = position >> BLIP_TIME_BITS;
+  uint32_t phase = (position >> (BLIP_TIME_BITS - BLIP_PHASE_BITS)) & (BLIP_PHASES - 1);
+
+  // Changes which do not fit the buffer are dropped: samples were not read in time
+  if(index >= _capacity) return;
+
+  int64_t* output = &_buffer[index];
+  for(int k = 0; k < BLIP_KERNEL_WIDTH; k++) output[k] += (int64_t)_kernel[phase][k] * delta;
+}
+
+/** Blip_buffer::end_frame
+    Terminate the current block. The following deltas are relative to the end of this block
+
+    @param duration uint32_t duration of the block, in clocks
+
+*/
+void Blip_buffer::end_frame(uint32_t duration){
+  _offset += duration * _factor;
+
+  // Samples were not read in time: the oldest ones are lost
+  uint64_t limit = (uint64_t)_capacity << BLIP_TIME_BITS;
+  if(_offset > limit) _offset = limit;
+}
+
+/** Blip_buffer::samples_available
+    @return uint32_t number of complete samples which can be read
+
+*/
+uint32_t Blip_buffer::samples_available(){
+  return _offset >> BLIP_TIME_BITS;
+}
+
+/** Blip_buffer::read_samples
+    Integrate and remove some complete samples from the buffer
+
+    @param output int16_t* destination of the samples
+    @param count uint32_t maximum number of samples to read
+    @param stride uint32_t distance between two samples in the destination (2 for interleaved stereo)
+    @return uint32_t number of samples read
+
+*/
+uint32_t Blip_buffer::read_samples(int16_t* output, uint32_t count, uint32_t stride){
+
+  uint32_t available = samples_available();
+  if(count > available) count = available;
+
+  for(uint32_t i = 0; i < count; i++){
+
+    // The integrator slowly leaks towards zero, which removes the DC offset
+    _integrator += _buffer[i] - (_integrator >> BLIP_BASS_SHIFT);
+
+    int64_t sample = _integrator >> (BLIP_KERNEL_BITS + _amplitude_shift);
+    if(sample >  32767) sample =  32767;
+    if(sample < -32768) sample = -32768;
+    output[i * stride] = (int16_t)sample;
+  }
+
+  // Move the samples still to be completed at the beginning of the buffer
+  uint32_t remaining = _buffer.size() - count;
+  memmove(_buffer.data(), _buffer.data() + count, remaining * sizeof(int64_t));
+  memset(_buffer.data() + remaining, 0, count * sizeof(int64_t));
+  _offset -= (uint64_t)count << BLIP_TIME_BITS;
+
+  return count;
+}
+
+/** Blip_buffer::clear
+    Remove all the samples and reset the output to silence
+
+*/
+void Blip_buffer::clear(){
+  std::fill(_buffer.begin(), _buffer.end(), 0);
+  _offset = 0;
+  _integrator = 0;
+}
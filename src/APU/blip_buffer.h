@@ -0,0 +1,70 @@
+#ifndef __BLIP_BUFFER_H
+#define __BLIP_BUFFER_H
+
+#include <cstdint>
+#include <vector>
+
+// Fractional bits of the time, expressed in output samples
+#define BLIP_TIME_BITS    32
+// Number of sub-sample positions of a step, and number of output samples it spans
+#define BLIP_PHASE_BITS   6
+#define BLIP_PHASES       (1 << BLIP_PHASE_BITS)
+#define BLIP_KERNEL_WIDTH 16
+// Fixed point unit of the kernel coefficients
+#define BLIP_KERNEL_BITS  15
+// Leak of the integrator, which removes the DC offset (about 15 Hz at 48 kHz)
+#define BLIP_BASS_SHIFT   9
+// Bandwidth of the steps, as a fraction of the Nyquist frequency
+#define BLIP_CUTOFF       0.9
+
+/*
+ * Band-limited step buffer. The input signal is described by its changes
+ * of amplitude (deltas), each placed at a time expressed in clocks of the
+ * input. Every delta is added to the output as a band-limited step, chosen
+ * among BLIP_PHASES precomputed ones according to the sub-sample position of
+ * the change (polyphase resampling). The output samples are obtained by
+ * integrating the steps.
+ *
+ * Usage, for each block of input:
+ *    add_delta(time, delta)  -> time is relative to the beginning of the block
+ *    end_frame(duration)     -> the block lasted `duration` clocks
+ *    read_samples(...)       -> take the samples which are complete
+ * */
+class Blip_buffer {
+
+  // Clocks of the input and samples of the output, per second
+  uint32_t _clock_rate;
+  uint32_t _sample_rate;
+
+  // Output samples per input clock, with BLIP_TIME_BITS fractional bits
+  uint64_t _factor;
+
+  // Time of the beginning of the current block, with the respect to the first sample in the buffer
+  uint64_t _offset;
+
+  // Sum of the steps not read yet, with BLIP_KERNEL_WIDTH samples of margin
+  std::vector<int64_t> _buffer;
+  uint32_t _capacity;
+
+  // Integrator state and amplitude shift of the output
+  int64_t  _integrator;
+  uint8_t  _amplitude_shift;
+
+  // Band-limited steps, one per sub-sample phase
+  int32_t  _kernel[BLIP_PHASES][BLIP_KERNEL_WIDTH];
+
+  void build_kernel();
+
+public:
+
+  Blip_buffer(uint32_t, uint32_t, uint32_t, uint8_t);
+  void     set_rates(uint32_t, uint32_t);
+  uint32_t get_sample_rate();
+  void     add_delta(uint32_t, int32_t);
+  void     end_frame(uint32_t);
+  uint32_t samples_available();
+  uint32_t read_samples(int16_t*, uint32_t, uint32_t);
+  void     clear();
+};
+
+#endif // __BLIP_BUFFER_H
@@ -1,4 +1,5 @@
 #include "HDMA.h"
+#include "../PPU/PPU.h"
 #include <cstdio>
 
 extern struct gb_global_t gb_global;
@@ -88,9 +89,9 @@ void HDMA::write(uint16_t addr, uint8_t data){
       // Different timings are required for the different modes
       _cycles_to_wait = (data & HDMA_HDMA5_CONTROL_BIT_MASK) ? 0 : 32;
 
-      // This variables tells the HDMA to start a chunk transfer as soon as the
-      // the next HBLANK phase starts
-      _hblank_to_do = 1;
+      // This variables tells the HDMA to start a chunk transfer. If the PPU is
+      // not in HBLANK, the transfer starts when it notifies the next HBLANK phase
+      _hblank_to_do = ppu->is_in_hblank();
 
       // HDMA5 must be always updated with the number of chunks still to be transferred (minus 1),
       // and the MSB tells whether the CPU can run or not.
@@ -134,6 +135,52 @@ HDMA::HDMA(std::string name, uint16_t init_addr) : Bus_obj(name, init_addr, 5){
   _destination_address = 0;
   _source_address = 0;
   _hblank_to_do = 0;
+
+  cart = nullptr;
+  ppu = nullptr;
+  _bus_to_sync = nullptr;
+}
+
+/** HDMA::hblank_entered
+    Notification from the PPU that a new HBLANK phase starts,
+    in which a chunk is transferred in HBLANK mode
+
+*/
+void HDMA::hblank_entered(){
+  if(_is_transfering and _transfering_mode == HDMA_HBLANK_DMA) _hblank_to_do = 1;
+}
+
+/** HDMA::transfer_chunk
+    Move the next chunk of 16 bytes. The source is resolved to the memory
+    of the object containing it, and the bytes are copied straight into the
+    current VRAM bank. The PPU is run first, since it renders from the VRAM.
+    Sources which are not plain memory and destinations out of the VRAM
+    still go through the bus
+
+    @param bus Bus_obj* pointer to a bus to use for reading and writing
+
+*/
+void HDMA::transfer_chunk(Bus_obj* bus){
+
+  uint16_t       src_addr = _source_address + _current_transfer * HDMA_CHUNK_SIZE;
+  uint16_t       dst_addr = _destination_address + _current_transfer * HDMA_CHUNK_SIZE;
+  const uint8_t* src;
+  uint8_t*       dst;
+
+  _bus_to_sync->catch_up_object(ppu);
+
+  src = bus->get_memory_pointer(src_addr, HDMA_CHUNK_SIZE);
+  dst = (dst_addr + HDMA_CHUNK_SIZE <= VRAM_END_ADDR) ? cart->get_vram_pointer() + (dst_addr - VRAM_INIT_ADDR) : nullptr;
+
+  if(src != nullptr and dst != nullptr){
+    memcpy(dst, src, HDMA_CHUNK_SIZE);
+    return;
+  }
+
+  for(int i = 0; i < HDMA_CHUNK_SIZE; i++){
+    if(dst != nullptr) dst[i] = bus->read(src_addr + i);
+    else               bus->write(dst_addr + i, bus->read(src_addr + i));
+  }
 }
 
 /** HDMA::step
@@ -143,8 +190,6 @@ HDMA::HDMA(std::string name, uint16_t init_addr) : Bus_obj(name, init_addr, 5){
 
 */
 void HDMA::step(Bus_obj* bus){
-  uint8_t current_STAT = 0;
-  uint8_t to_move;
 
   // In non-gbc mode no hdma is allowed. Also,
   // no step is required if transfering is being done
@@ -161,10 +206,7 @@ void HDMA::step(Bus_obj* bus){
     if(_cycles_to_wait-- != 0) return;
 
     // In 32 cycles, HDMA is able to move 0x10 bytes
-    for(int i = 0; i < 0x10; i++){
-      to_move = bus->read(_source_address + _current_transfer * 0x10 + i);
-      bus->write(_destination_address + _current_transfer * 0x10 + i, to_move);
-    }
+    transfer_chunk(bus);
 
     // Move to next transfer and proper cycles to wait
     _current_transfer++, _cycles_to_wait = 32;
@@ -179,20 +221,11 @@ void HDMA::step(Bus_obj* bus){
 
   /*
    * In HBLANK mode, for each HBLANK phase of the PPU, 0x10 bytes are transferred.
-   * During these transfers, the CPU cannot work.
+   * During these transfers, the CPU cannot work. The PPU notifies the start of
+   * each HBLANK phase, so that the transfer can begin.
    * */
   else{
 
-    // You need to know if you are in HBLANK
-    current_STAT  = bus->read(PPU_STAT);
-
-    // If we entered mode 2 of PPU, then we can perform a transfer
-    // once that we find a new HBLANK mode
-    if((current_STAT & 0x03) == 0x02) _hblank_to_do = 1;
-
-    // If the current mode is not HBLANK, there is nothing to do.
-    if((current_STAT & 0x03) != 0x00) return;
-
     // After a transfer is done, 32 cycles must be waited. Once
     // this time is passed, the MSB of HDMA5 is set.
     if(_cycles_to_wait){
@@ -215,10 +248,7 @@ void HDMA::step(Bus_obj* bus){
     if(_hblank_to_do){
 
       // In 32 cycles, HDMA is able to move 0x10 bytes
-      for(int i = 0; i < 16; i++){
-        to_move = bus->read(_source_address + _current_transfer * 0x10 + i);
-        bus->write(_destination_address + _current_transfer * 0x10 + i, to_move);
-      }
+      transfer_chunk(bus);
 
       _current_transfer++;
       _cycles_to_wait = 32;
@@ -2,6 +2,8 @@
 #define __HDMA_H
 
 #include "../bus/bus_obj.h"
+#include "../bus/bus.h"
+#include "../memory/cartridge.h"
 #include "../memory/memory_map.h"
 #include "../utils/gb_global_t.h"
 #include <cstdint>
@@ -11,6 +13,9 @@
 #define HDMA_GP_DMA 0
 #define HDMA_HBLANK_DMA 1
 #define HDMA_HDMA5_CONTROL_BIT_MASK 0x80
+#define HDMA_CHUNK_SIZE 0x10
+
+class PPU;
 
 class HDMA : public Bus_obj {
 
@@ -29,12 +34,25 @@ class HDMA : public Bus_obj {
   uint16_t _source_address;
   uint8_t  _hblank_to_do;
 
+  void    transfer_chunk(Bus_obj*);
+
 public:
 
+  // The chunks are copied straight into the VRAM of the cartridge, once the
+  // PPU is up to date. In HBLANK mode, the PPU notifies when HBLANK starts
+  Cartridge* cart;
+  PPU* ppu;
+  Bus* _bus_to_sync;
+
   HDMA(std::string, uint16_t);
   uint8_t read(uint16_t);
   void    write(uint16_t, uint8_t);
   void    step(Bus_obj*);
+  void    hblank_entered();
+
+  // The CPU cannot run while a chunk is transferred, which is indicated by
+  // the MSB of HDMA5 being 0
+  bool    is_stalling_cpu(){ return !(HDMA5 & HDMA_HDMA5_CONTROL_BIT_MASK); }
 
 };
 
@@ -1,5 +1,6 @@
 #include "joypad.h"
 #include <cstdint>
+#include <cstring>
 
 extern struct gb_global_t gb_global;
 
@@ -50,6 +51,19 @@ void Joypad::write(uint16_t addr, uint8_t data){
 */
 Joypad::Joypad(std::string name, uint16_t init_addr) : Bus_obj(name, init_addr, 1){
   JOYP = 0xcf;
+  memset(_scripted_keys, 0, JOYPAD_SCRIPTED_KEYS);
+}
+
+/** Joypad::set_scripted_keys
+    Set the keys which are held in headless mode, replacing the
+    previous ones
+
+    @param keys const std::vector<uint8_t>& scancodes of the held keys
+
+*/
+void Joypad::set_scripted_keys(const std::vector<uint8_t>& keys){
+  memset(_scripted_keys, 0, JOYPAD_SCRIPTED_KEYS);
+  for(auto key : keys) _scripted_keys[key] = 1;
 }
 
 /** Joypad::step
@@ -86,6 +100,10 @@ void Joypad::set_interrupt(Bus_obj* bus){
     @return bool whether the key is pressed or not
 */
 bool Joypad::key_is_pressed(uint8_t ks) {
+
+  // No keyboard is available in headless mode: keys come from the input script
+  if(gb_global.headless) return _scripted_keys[ks];
+
   const Uint8* state = SDL_GetKeyboardState(nullptr);
   SDL_Event e;
 
@@ -8,6 +8,7 @@
 #include <SDL2/SDL.h>
 #include "../utils/gb_global_t.h"
 #include <stdexcept>
+#include <vector>
 
 #define JOYPAD_VOLUME_DEBOUNCING_DELAY 400
 #define JOYPAD_MAX_VOLUME 10
@@ -40,10 +41,15 @@
 #define JOYPAD_VOLUME_UP_BUTTON   SDL_SCANCODE_P
 #define JOYPAD_VOLUME_DOWN_BUTTON SDL_SCANCODE_O
 
+#define JOYPAD_SCRIPTED_KEYS 256
+
 class Joypad : public Bus_obj {
 
   uint8_t JOYP;
 
+  // Keys held in headless mode, indexed by scancode
+  uint8_t _scripted_keys[JOYPAD_SCRIPTED_KEYS];
+
   void    set_interrupt(Bus_obj*);
   bool    key_is_pressed(uint8_t);
   bool    update_JOYP();
@@ -54,6 +60,7 @@ public:
   uint8_t read(uint16_t);
   void    write(uint16_t, uint8_t);
   void    step(Bus_obj*);
+  void    set_scripted_keys(const std::vector<uint8_t>&);
 
 };
 
@@ -49,6 +49,18 @@ void Serial::write(uint16_t addr, uint8_t data){
   }
 }
 
+/** Serial::set_io_handlers
+    Let the bus access the registers directly through the IO table.
+    The serial must be connected to the bus
+
+    @param bus Bus* bus the serial is connected to
+
+*/
+void Serial::set_io_handlers(Bus* bus){
+  bus->set_io_handler(init_addr,     io_read_register<Serial, &Serial::SB>, io_write_register<Serial, &Serial::SB>, 0);
+  bus->set_io_handler(init_addr + 1, io_read_register<Serial, &Serial::SC>, io_write_register<Serial, &Serial::SC>, 0);
+}
+
 /** Serial::Serial
     Serial constructor, setting init_addr of the serial in the memory space
     The size of the object is fixed to 2.
@@ -2,6 +2,7 @@
 #define __SERIAL_H
 
 #include "../bus/bus_obj.h"
+#include "../bus/bus.h"
 #include "../memory/memory_map.h"
 #include <cstdint>
 #include <string>
@@ -18,6 +19,7 @@ public:
   uint8_t read(uint16_t);
   void    write(uint16_t, uint8_t);
   void    step(Bus_obj*);
+  void    set_io_handlers(Bus*);
   void    set_interrupt(Bus_obj*);
 
 };
@@ -25,7 +25,7 @@ uint8_t Timer::read(uint16_t addr){
     res =  TMA;
   }
   else if (addr == 3){
-    res =  (TAC | 0b11111000);
+    res =  (TAC | TIMER_TAC_READ_MASK);
   }
   else{
     std::invalid_argument("Invalid address while acessing timer");
@@ -44,6 +44,9 @@ uint8_t Timer::read(uint16_t addr){
 void Timer::write(uint16_t addr, uint8_t data){
 
   if(addr == 0){
+    // Resetting DIV is a falling edge for all its bits set. The APU
+    // is already up to date, as it is synchronized on timer writes
+    if(DIV & frame_sequencer_mask()) apu->frame_sequencer_step();
     DIV = 0;
   }
   else if (addr == 1){
@@ -69,6 +72,32 @@ void Timer::write(uint16_t addr, uint8_t data){
   }
 }
 
+/** Timer::read_DIV
+    Read handler of DIV in the IO table, of which only the 8 msbs are accessible
+
+    @param obj Bus_obj* timer owning the register
+    @return uint8_t read byte
+
+*/
+uint8_t Timer::read_DIV(Bus_obj* obj, uint16_t){
+  return static_cast<Timer*>(obj)->DIV >> 8;
+}
+
+/** Timer::set_io_handlers
+    Let the bus read the registers directly through the IO table. The writes of
+    DIV, TIMA and TAC still go through `write`, as they have other effects.
+    The timer must be connected to the bus
+
+    @param bus Bus* bus the timer is connected to
+
+*/
+void Timer::set_io_handlers(Bus* bus){
+  bus->set_io_handler(init_addr,     read_DIV,                             nullptr,                             0);
+  bus->set_io_handler(init_addr + 1, io_read_register<Timer, &Timer::TIMA>, nullptr,                             0);
+  bus->set_io_handler(init_addr + 2, io_read_register<Timer, &Timer::TMA>,  io_write_register<Timer, &Timer::TMA>, 0);
+  bus->set_io_handler(init_addr + 3, io_read_register<Timer, &Timer::TAC>,  nullptr,                             TIMER_TAC_READ_MASK);
+}
+
 /** Timer::Timer
     Timer constructor, setting init_addr of the timer in the memory space
     The size of the object is fixed to 4.
@@ -87,6 +116,26 @@ Timer::Timer(std::string name, uint16_t init_addr) : Bus_obj(name, init_addr, 4)
   cycles_to_interrupt = 0;
   interrupt_aborted = 0;
   current_speed = 0;
+
+  apu = nullptr;
+  _bus_to_sync = nullptr;
+}
+
+/** Timer::frame_sequencer_mask
+    @return uint16_t mask of the DIV bit driving the APU frame sequencer
+
+*/
+uint16_t Timer::frame_sequencer_mask(){
+  return (current_speed == 0) ? (1 << TIMER_FRAME_SEQUENCER_BIT) : (1 << TIMER_FRAME_SEQUENCER_BIT_DOUBLE);
+}
+
+/** Timer::frame_sequencer_step
+    Run the APU up to the current cycle and perform a step of its frame sequencer
+
+*/
+void Timer::frame_sequencer_step(){
+  _bus_to_sync->catch_up_object(apu);
+  apu->frame_sequencer_step();
 }
 
 /** Timer::step
@@ -102,6 +151,10 @@ void Timer::step(Bus_obj* bus){
   // stores whether the timer was working in double speed or not. For this reason, is `current_speed` and
   // `gb_global.double_speed` mismatch, a change of speed is required. After that, nothing changes in the
   // timer bheaviour
+  // The switch also changes the DIV bit observed by the frame sequencer, which
+  // is a falling edge if the old bit was set and the new one is not
+  uint16_t sequencer_mask = frame_sequencer_mask();
+
   if(gb_global.gbc_mode == 1 and gb_global.double_speed == 1 and current_speed == 0){
     this->frequency *= 2;
     current_speed = 1;
@@ -111,6 +164,8 @@ void Timer::step(Bus_obj* bus){
     current_speed = 0;
   }
 
+  if((DIV & sequencer_mask) and !(DIV & frame_sequencer_mask())) frame_sequencer_step();
+
   uint8_t bit_position;
   uint8_t bit_position_value;
   uint8_t bit_timer_enable;
@@ -118,6 +173,10 @@ void Timer::step(Bus_obj* bus){
 
   DIV += 1;
 
+  // Falling edge of the DIV bit driving the APU frame sequencer
+  if((DIV & frame_sequencer_mask()) == 0 and ((DIV - 1) & frame_sequencer_mask()) != 0)
+    frame_sequencer_step();
+
   bit_position = ((TAC & CLOCK_SELECT_MASK) == 0) ? 9 :
                  ((TAC & CLOCK_SELECT_MASK) == 1) ? 3 :
                  ((TAC & CLOCK_SELECT_MASK) == 2) ? 5 :
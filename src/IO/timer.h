@@ -2,6 +2,8 @@
 #define __TIMER_H
 
 #include "../bus/bus_obj.h"
+#include "../bus/bus.h"
+#include "../APU/APU.h"
 #include "../memory/memory_map.h"
 #include "../utils/gb_global_t.h"
 #include <cstdint>
@@ -9,8 +11,15 @@
 #include <stdexcept>
 
 #define CLOCK_SELECT_MASK 0b00000011
+// Only the 3 lsbs of TAC are implemented
+#define TIMER_TAC_READ_MASK 0b11111000
 #define TIMER_ENABLE_POS 2
 
+// Bits of DIV whose falling edge steps the frame sequencer of the APU,
+// in single and double speed mode
+#define TIMER_FRAME_SEQUENCER_BIT        13
+#define TIMER_FRAME_SEQUENCER_BIT_DOUBLE 14
+
 class Timer : public Bus_obj {
 
   uint16_t DIV;
@@ -24,12 +33,22 @@ class Timer : public Bus_obj {
 
   uint8_t current_speed;
 
+  uint16_t frame_sequencer_mask();
+  void     frame_sequencer_step();
+  static uint8_t read_DIV(Bus_obj*, uint16_t);
+
 public:
 
+  // The APU frame sequencer is notified by the timer, after the APU is brought
+  // up to date through the bus
+  APU* apu;
+  Bus* _bus_to_sync;
+
   Timer(std::string, uint16_t);
   uint8_t read(uint16_t);
   void    write(uint16_t, uint8_t);
   void    step(Bus_obj*);
+  void    set_io_handlers(Bus*);
   void    set_interrupt(Bus_obj*);
 
 };
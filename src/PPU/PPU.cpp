@@ -13,6 +13,8 @@ extern struct gb_global global_vars;
 */
 PPU::PPU(std::string name, uint16_t init_addr) : Bus_obj(name, init_addr, 12){
   this->display = new Display(SCREEN_WIDTH, SCREEN_HEIGHT, SCALE_FACTOR);
+  this->catch_up = true;
+  this->hdma = nullptr;
   reset();
 }
 
@@ -66,10 +68,8 @@ void PPU::write(uint16_t addr, uint8_t data){
   else if(addr == (PPU_DMA  - PPU_BASE)){
     // Can only use addresses between 0x0000 and 0xdf00 as source
     DMA  = (data > 0xdf) ? 0xdf : data;
-    // It's always 160 bytes to transfer = 40 objects, 4 bytes each
-    _DMA_bytes_to_transfer = 0xA0;
-    // 1 dma operation requires 1 M-cycle = 4 T-cycles
-    _DMA_cycles_to_wait = 0;
+    // The source is resolved and copied on the next step
+    _DMA_to_start = true;
   }
   else if(addr == (PPU_BGP  - PPU_BASE)) BGP  = data;
   else if(addr == (PPU_OBP0 - PPU_BASE)) OBP0 = data;
@@ -80,6 +80,29 @@ void PPU::write(uint16_t addr, uint8_t data){
 
 }
 
+/** PPU::set_io_handlers
+    Let the bus access the registers directly through the IO table. The writes
+    of STAT, LY and DMA still go through `write`, as they have other effects.
+    The PPU must be connected to the bus
+
+    @param bus Bus* bus the PPU is connected to
+
+*/
+void PPU::set_io_handlers(Bus* bus){
+  bus->set_io_handler(PPU_LCDC, io_read_register<PPU, &PPU::LCDC>, io_write_register<PPU, &PPU::LCDC>, 0);
+  bus->set_io_handler(PPU_STAT, io_read_register<PPU, &PPU::STAT>, nullptr,                           0);
+  bus->set_io_handler(PPU_SCY,  io_read_register<PPU, &PPU::SCY>,  io_write_register<PPU, &PPU::SCY>,  0);
+  bus->set_io_handler(PPU_SCX,  io_read_register<PPU, &PPU::SCX>,  io_write_register<PPU, &PPU::SCX>,  0);
+  bus->set_io_handler(PPU_LY,   io_read_register<PPU, &PPU::LY>,   nullptr,                           0);
+  bus->set_io_handler(PPU_LYC,  io_read_register<PPU, &PPU::LYC>,  io_write_register<PPU, &PPU::LYC>,  0);
+  bus->set_io_handler(PPU_DMA,  io_read_register<PPU, &PPU::DMA>,  nullptr,                           0);
+  bus->set_io_handler(PPU_BGP,  io_read_register<PPU, &PPU::BGP>,  io_write_register<PPU, &PPU::BGP>,  0);
+  bus->set_io_handler(PPU_OBP0, io_read_register<PPU, &PPU::OBP0>, io_write_register<PPU, &PPU::OBP0>, 0);
+  bus->set_io_handler(PPU_OBP1, io_read_register<PPU, &PPU::OBP1>, io_write_register<PPU, &PPU::OBP1>, 0);
+  bus->set_io_handler(PPU_WY,   io_read_register<PPU, &PPU::WY>,   io_write_register<PPU, &PPU::WY>,   0);
+  bus->set_io_handler(PPU_WX,   io_read_register<PPU, &PPU::WX>,   io_write_register<PPU, &PPU::WX>,   0);
+}
+
 /** PPU::step
     Perform the step of the PPU at each T-cycle.
 
@@ -97,6 +120,9 @@ void PPU::step(Bus_obj* bus){
     _state = State::STATE_MODE_0;
     STAT &= 0b11111100;
 
+    // The OAM DMA does not depend on the LCD, and goes on while it is off
+    DMA_OAM_step(bus);
+
     // reset();
     return;
   }
@@ -112,6 +138,53 @@ void PPU::step(Bus_obj* bus){
   STAT_handler(bus);
 }
 
+/** PPU::run
+    Perform several T-cycles at once. The cycles in which the PPU only waits
+    are skipped in bulk, while the cycles in which something happens (change
+    of mode, rendering of a line, interrupt, DMA) are performed with `step`.
+    Since the bus runs the PPU before any access to its registers, to the VRAM,
+    to the OAM or to the CRAM, the lines are rendered with the same values
+    they would have when stepping each cycle (mid-frame raster effects included).
+
+    @param bus Bus_obj* pointer to a bus to use for reading
+    @param cycles uint32_t number of T-cycles to perform
+
+*/
+void PPU::run(Bus_obj* bus, uint32_t cycles){
+  while(cycles != 0){
+    uint32_t to_event = get_cycles_to_event();
+
+    if(to_event > cycles){
+      skip(bus, cycles);
+      return;
+    }
+
+    skip(bus, to_event - 1);
+    step(bus);
+    cycles -= to_event;
+  }
+}
+
+/** PPU::get_cycles_to_event
+    Number of T-cycles until the next one which cannot be skipped
+
+    @return uint32_t number of T-cycles, at least 1
+
+*/
+uint32_t PPU::get_cycles_to_event(){
+
+  // The first cycle with LCD off resets the status, then nothing happens
+  if(!is_PPU_on()){
+    if(LY != 0 or _state != State::STATE_MODE_0 or (STAT & STAT_PPU_MODE_MASK) or _DMA_to_start) return 1;
+    return PPU_IDLE_EVENT_CYCLES;
+  }
+
+  // The start of a DMA transfer and STAT interrupts are handled cycle by cycle
+  if(_DMA_to_start or (_STAT_can_fire and STAT_condition())) return 1;
+
+  return get_cycles_to_transition();
+}
+
 /** PPU::set_vblank_interrupt
     Set the corresponding interrupt flag in the IF register.
     In the OOP approach that is followed in the project, first the
@@ -144,6 +217,27 @@ void PPU::set_stat_interrupt(Bus_obj* bus){
   bus->write(IF_ADDRESS, interrupt_flag_value);
 }
 
+/** PPU::is_in_hblank
+    Check if the PPU is in HBLANK, which is also the case when it is off
+
+    @return bool true if the mode in STAT is 0
+
+*/
+bool PPU::is_in_hblank(){
+  return (STAT & STAT_PPU_MODE_MASK) == 0;
+}
+
+/** PPU::get_display_matrix
+    Return the content of the last rendered frame, as an array
+    of SCREEN_WIDTH * SCREEN_HEIGHT colors in RGB888 format
+
+    @return const uint32_t* content of the screen
+
+*/
+const uint32_t* PPU::get_display_matrix(){
+  return _DRAWING_display_matrix;
+}
+
 /** PPU::~PPU
     Destroys the SDL2 display object
 
@@ -2,6 +2,7 @@
 #define __PPU_H
 
 #include "../bus/bus_obj.h"
+#include "../bus/bus.h"
 #include "display.h"
 #include "PPU_def.h"
 #include <cstdint>
@@ -11,6 +12,7 @@
 #include "../memory/memory_map.h"
 #include "../memory/cartridge.h"
 #include "../memory/CRAM.h"
+#include "../IO/HDMA.h"
 #include "../utils/gb_global_t.h"
 
 class PPU : public Bus_obj {
@@ -40,8 +42,8 @@ class PPU : public Bus_obj {
 
   bool     _STAT_can_fire;
 
-  uint8_t  _DMA_bytes_to_transfer;
-  uint8_t  _DMA_cycles_to_wait;
+  // The OAM DMA copies the 160 bytes at once, on the step after the write
+  bool     _DMA_to_start;
 
   uint8_t  _OAM_SCAN_to_wait;
   uint8_t  _OAM_SCAN_fetched;
@@ -67,6 +69,9 @@ class PPU : public Bus_obj {
   bool is_PPU_on();
   void reset();
   void STAT_handler(Bus_obj*);
+  bool STAT_condition();
+  void skip(Bus_obj*, uint32_t);
+  uint32_t get_cycles_to_transition();
   uint8_t get_sprite_height();
   uint32_t get_color_from_palette(uint8_t, uint8_t);
 
@@ -74,11 +79,18 @@ public:
 
   Cartridge* cart;
   CRAM* cram;
+  Memory* oam;
+  HDMA* hdma;
 
   PPU(std::string, uint16_t);
   uint8_t read(uint16_t);
   void    write(uint16_t, uint8_t);
   void    step(Bus_obj*);
+  void    run(Bus_obj*, uint32_t);
+  uint32_t get_cycles_to_event();
+  void    set_io_handlers(Bus*);
+  bool    is_in_hblank();
+  const uint32_t* get_display_matrix();
   ~PPU();
 
 };
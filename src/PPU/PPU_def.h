@@ -45,4 +45,7 @@
 
 #define PPU_DRAWING_TO_WAIT 172
 
+// While the LCD is off, the PPU has nothing to do
+#define PPU_IDLE_EVENT_CYCLES 0x10000
+
 #endif // !__PPU_DEF_H
@@ -3,7 +3,6 @@
 #include <cstdint>
 #include <cstdio>
 #include <iostream>
-#include <chrono>
 
 extern gb_global_t gb_global;
 
@@ -26,8 +25,7 @@ void PPU::reset(){
   WX    = 0;
   WY    = 0;
 
-  _DMA_bytes_to_transfer = 0;
-  _DMA_cycles_to_wait = 0;
+  _DMA_to_start = false;
 
   _OAM_SCAN_to_wait = 0;
   _OAM_SCAN_fetched = 0;
@@ -38,52 +36,41 @@ void PPU::reset(){
 
   for(int i = 0; i < OAM_BUFFER_SIZE_BYTE; i++) _OAM_SCAN_buffer[i] = 0;
 
+  _DRAWING_to_wait = 0;
+  _HBLANK_padding_to_wait = 0;
+  _VBLANK_padding_to_wait = 0;
+  _STAT_can_fire = false;
+
   _state = State::STATE_MODE_2;
 
 }
 
 /** PPU::DMA_OAM_step
-    Performs a step of the DMA operation. Each transfer
-    requires 1 M-cycle (== 4 T-cycles).
+    Performs a step of the DMA operation. The source is resolved once to
+    the memory of the object containing it, and the 160 bytes are copied
+    straight into the OAM on the step after the write of the DMA register.
 
-    @param bus Bus_obj* pointer to a bus to use for reading and writing
+    @param bus Bus_obj* pointer to a bus to use for reading
 
 */
 void PPU::DMA_OAM_step(Bus_obj* bus){
 
-  uint16_t src_addr;
-  uint16_t dst_addr;
-  uint8_t  byte_addr;
+  uint16_t       src_addr;
+  const uint8_t* src;
+  uint8_t*       dst;
 
-  // Nothing to transfer
-  if(_DMA_bytes_to_transfer == 0) return;
+  if(!_DMA_to_start) return;
 
-  // Some cycles to wait
-  if(_DMA_cycles_to_wait != 0){
-    _DMA_cycles_to_wait--;
-    return;
-  }
+  src_addr = DMA << 8;
+  src = bus->get_memory_pointer(src_addr, OAM_SIZE);
+  dst = oam->get_data();
 
-  // Since internal timing of DMA operation is unknown, a possibility is
-  // to consider both the reading and the writing happening in the same
-  // T-cycle. This is clearly impossible from a bus perspective
-
-  // Next byte to write
-  byte_addr = OAM_SIZE - _DMA_bytes_to_transfer;
-  // Source address
-  src_addr  = (DMA << 8) | byte_addr;
-  // Destination address
-  dst_addr  = OAM_INIT_ADDR | byte_addr;
-
-  // Perform the DMA operation
-  bus->write(dst_addr, bus->read(src_addr));
-
-  // Setup next byte to transfer
-  if(_DMA_bytes_to_transfer-- != 0){
-    // CGB double speed has an impact on the DMA speed, making it two times as fast
-    _DMA_cycles_to_wait = (gb_global.double_speed == 1) ? 1 : 3;
-  }
+  // Sources which are not plain memory (disabled cartridge RAM, RTC...)
+  // are still read through the bus
+  if(src != nullptr) memcpy(dst, src, OAM_SIZE);
+  else for(uint16_t i = 0; i < OAM_SIZE; i++) dst[i] = bus->read(src_addr + i);
 
+  _DMA_to_start = false;
 }
 
 /** PPU::OAM_SCAN_step
@@ -443,6 +430,9 @@ void PPU::DRAWING_step(Bus_obj*){
   // Move to HBLANK
   _state = State::STATE_MODE_0;
   _HBLANK_padding_to_wait = 284;
+
+  // A chunk of an HBLANK DMA transfer can start
+  if(hdma != nullptr) hdma->hblank_entered();
 }
 
 /** PPU::HBLANK_step
@@ -491,12 +481,6 @@ void PPU::HBLANK_step(Bus_obj* bus){
 */
 void PPU::VBLANK_step(Bus_obj*){
 
-  #ifdef __DEBUG
-  // FPS counter variables
-  static int counter = 0;
-  static auto start = std::chrono::system_clock::now();
-  #endif
-
   _VBLANK_padding_to_wait--;
 
   // Pseudo-scanline still to go
@@ -514,14 +498,8 @@ void PPU::VBLANK_step(Bus_obj*){
     // Update the screen with the current frame
     display->update(_DRAWING_display_matrix);
 
-    #ifdef __DEBUG
-    // FPS counting, each 10 seconds
-    if(++counter % (60*10) == 0){
-      auto elapsed = std::chrono::system_clock::now() - start;
-      std::cout << "[FPS: " << (60*10)*((float)(1000000000)/(elapsed.count())) << "\t]\n";
-      start =  std::chrono::system_clock::now();
-    }
-    #endif
+    // Notify the gameboy that a new frame is available
+    gb_global.frame_ready = 1;
 
     _state = State::STATE_MODE_2;
     LY = 0;
@@ -548,18 +526,58 @@ uint8_t PPU::get_sprite_height(){
   return (LCDC & PPU_LCDC_SPRITE_SIZE_MASK) ? 16 : 8;
 }
 
-/** PPU::STAT_handler
-    At each PPU step, updates STAT and possibly raise an
-    interrupt
+/** PPU::get_cycles_to_transition
+    Number of T-cycles until the current mode performs some work: fetching
+    the last object of the OAM scan, rendering the line, moving to the next
+    scanline or to the next frame. The counters are decremented before being
+    checked, so a counter equal to 0 wraps around.
 
-    @param bus Bus_obj* pointer to a bus to use for reading and writing
+    @return uint32_t number of T-cycles, at least 1
 
 */
-void PPU::STAT_handler(Bus_obj* bus){
+uint32_t PPU::get_cycles_to_transition(){
+
+  if(_state == State::STATE_MODE_2){
+    // Objects still to fetch, each taking 2 cycles but the first one
+    uint32_t to_fetch = (OAM_SIZE - _OAM_SCAN_addr) / 4;
+    return _OAM_SCAN_to_wait + 1 + 2 * (to_fetch - 1);
+  }
+  if(_state == State::STATE_MODE_3) return (_DRAWING_to_wait        == 0) ? 0x100   : _DRAWING_to_wait;
+  if(_state == State::STATE_MODE_0) return (_HBLANK_padding_to_wait == 0) ? 0x10000 : _HBLANK_padding_to_wait;
+  return                                   (_VBLANK_padding_to_wait == 0) ? 0x10000 : _VBLANK_padding_to_wait;
+}
+
+/** PPU::skip
+    Perform some T-cycles in which the PPU is only waiting, which must be
+    less than the ones returned by `get_cycles_to_event`
+
+    @param bus Bus_obj* pointer to a bus to use for reading
+    @param cycles uint32_t number of T-cycles to skip
+
+*/
+void PPU::skip(Bus_obj* bus, uint32_t cycles){
+
+  if(cycles == 0 or !is_PPU_on()) return;
+
+  // The OAM scan reads the objects while going on: reading them now gives
+  // the same result, since the bus runs the PPU before any OAM write
+  if      (_state == State::STATE_MODE_2) for(uint32_t i = 0; i < cycles; i++) OAM_SCAN_step(bus);
+  else if (_state == State::STATE_MODE_3) _DRAWING_to_wait        -= cycles;
+  else if (_state == State::STATE_MODE_0) _HBLANK_padding_to_wait -= cycles;
+  else                                    _VBLANK_padding_to_wait -= cycles;
+
+  // No interrupt can be fired, since mode and LY did not change
+  STAT_handler(bus);
+}
+
+/** PPU::STAT_condition
+    Check if any of the enabled STAT interrupt conditions is active
+
+    @return bool true if a condition is active
+
+*/
+bool PPU::STAT_condition(){
 
-  // If an interrupt had been fired but one condition is still active,
-  // no more conditions can be fired. If this variable is false after the
-  // conditions are checked, then on the next CC a new interrupt can be fired
   bool found_interrupt = false;
 
   // Fire if LYC == LY
@@ -582,6 +600,23 @@ void PPU::STAT_handler(Bus_obj* bus){
     if(_state == State::STATE_MODE_0) found_interrupt = true;
   }
 
+  return found_interrupt;
+}
+
+/** PPU::STAT_handler
+    At each PPU step, updates STAT and possibly raise an
+    interrupt
+
+    @param bus Bus_obj* pointer to a bus to use for reading and writing
+
+*/
+void PPU::STAT_handler(Bus_obj* bus){
+
+  // If an interrupt had been fired but one condition is still active,
+  // no more conditions can be fired. If this variable is false after the
+  // conditions are checked, then on the next CC a new interrupt can be fired
+  bool found_interrupt = STAT_condition();
+
   // Fire only if an interrupt was found and STAT can be fired
   if(found_interrupt and _STAT_can_fire){
     _STAT_can_fire = false;
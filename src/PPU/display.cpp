@@ -1,6 +1,8 @@
 #include "display.h"
 #include <stdexcept>
 
+extern struct gb_global_t gb_global;
+
 /** Display::Display
     Constructor of the class.
     Creates the window and the renderer for SDL2
@@ -21,6 +23,9 @@ Display::Display(uint8_t W, uint8_t H, uint8_t S) {
   scale_factor = S;
   last_cleared = false;
 
+  // No window is created in headless mode
+  if(gb_global.headless) return;
+
   // Init SDL
   if(SDL_Init(SDL_INIT_VIDEO) != 0){
     std::runtime_error("SDL_Init failed");
@@ -54,6 +59,8 @@ void Display::update(uint32_t* data){
   uint8_t* pixels;
   int pitch = 0;
 
+  if(gb_global.headless) return;
+
   // Clear renderer
   SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
   SDL_RenderClear(renderer);
@@ -77,7 +84,7 @@ void Display::update(uint32_t* data){
 */
 void Display::clear(uint32_t color){
 
-  if(last_cleared) return;
+  if(last_cleared or gb_global.headless) return;
 
   // Conversion from RGB555 to RGB888
   SDL_SetRenderDrawColor( this->renderer,
@@ -103,6 +110,8 @@ void Display::clear(uint32_t color){
 
 */
 Display::~Display(){
+  if(gb_global.headless) return;
+
   SDL_DestroyRenderer(renderer);
   SDL_DestroyWindow(window);
   SDL_Quit();
@@ -5,6 +5,7 @@
 #include <SDL2/SDL.h>
 #include <stdexcept>
 #include "PPU_def.h"
+#include "../utils/gb_global_t.h"
 
 class Display {
   SDL_Renderer *renderer;
@@ -1,6 +1,5 @@
 #include "bus.h"
 #include <unistd.h>
-#include <SDL.h>
 
 extern struct gb_global_t gb_global;
 
@@ -17,7 +16,34 @@ extern struct gb_global_t gb_global;
 Bus::Bus(std::string name, uint16_t init_addr, uint16_t size, uint32_t frequency) :
   Bus_obj(name, init_addr, size){
   this->set_frequency(frequency);
-  current_cycles_counting = 0;
+  current_cc = 0;
+  profiler = nullptr;
+
+  for(auto& io : io_table) io = {nullptr, 0, 0, io_read_object, io_write_object, 0};
+}
+
+/** io_read_object
+    Default read handler of the IO registers, going through the object
+
+    @param obj Bus_obj* object owning the register
+    @param addr uint16_t address relative to the object
+    @return uint8_t read byte
+
+*/
+uint8_t io_read_object(Bus_obj* obj, uint16_t addr){
+  return obj->read(addr);
+}
+
+/** io_write_object
+    Default write handler of the IO registers, going through the object
+
+    @param obj Bus_obj* object owning the register
+    @param addr uint16_t address relative to the object
+    @param data uint8_t byte to write
+
+*/
+void io_write_object(Bus_obj* obj, uint16_t addr, uint8_t data){
+  obj->write(addr, data);
 }
 
 /** Bus::add_to_bus
@@ -68,12 +94,124 @@ void Bus::add_to_bus(Bus_obj* new_object){
   frequency_cache.push_back(new_object->get_frequency());
   init_addr_cache.push_back(new_object->get_init_addr());
   size_cache.push_back(new_object->get_size());
+  catch_up_cache.push_back(new_object->is_catch_up());
+  pending_cycles.push_back(0);
+  event_countdown.push_back(new_object->get_cycles_to_event());
+  read_sync.push_back({});
+  write_sync.push_back({});
+
+  // A catch-up object must be up to date whenever it is accessed
+  if(new_object->is_catch_up()) add_sync_dependency(new_object, new_object, true);
+
+  // The IO registers of the object are reached through the IO table
+  for(uint32_t addr = new_object->get_init_addr(); addr < (uint32_t)new_object->get_init_addr() + new_object->get_size(); addr++){
+    if(addr < IO_TABLE_INIT_ADDR or addr >= IO_TABLE_INIT_ADDR + IO_TABLE_SIZE) continue;
+    io_table[addr - IO_TABLE_INIT_ADDR] = {new_object, (uint32_t)(bus_objects.size() - 1),
+                                           (uint16_t)(addr - new_object->get_init_addr()),
+                                           io_read_object, io_write_object, 0};
+  }
+}
+
+/** Bus::set_io_handler
+    Replace the handlers of an IO register, which must belong to an
+    object already connected to the bus. The catch-up objects are still
+    brought up to date before the handlers are called
+
+    @param addr uint16_t address of the register
+    @param read Io_read_handler handler of the reads, nullptr to go through the object
+    @param write Io_write_handler handler of the writes, nullptr to go through the object
+    @param read_mask uint8_t bits always read as 1
+
+*/
+void Bus::set_io_handler(uint16_t addr, Io_read_handler read, Io_write_handler write, uint8_t read_mask){
+
+  if(addr < IO_TABLE_INIT_ADDR or addr >= IO_TABLE_INIT_ADDR + IO_TABLE_SIZE)
+    throw std::invalid_argument("Address is not an IO register");
+
+  Io_handler& io = io_table[addr - IO_TABLE_INIT_ADDR];
+  if(io.obj == nullptr)
+    throw std::invalid_argument("IO register is not connected to the bus");
+
+  io.read      = (read  != nullptr) ? read  : io_read_object;
+  io.write     = (write != nullptr) ? write : io_write_object;
+  io.read_mask = read_mask;
+}
+
+/** Bus::get_object_index
+    Return the position of an object in the list of objects of the bus
+
+    @param object Bus_obj* object to look for
+    @return uint32_t index of the object
+
+*/
+uint32_t Bus::get_object_index(Bus_obj* object){
+  for(uint32_t i = 0; i < bus_objects.size(); i++)
+    if(bus_objects[i] == object) return i;
+  throw std::invalid_argument("Object " + object->name + " is not connected to the bus");
+}
+
+/** Bus::add_sync_dependency
+    Make sure that a catch-up object is run up to the current cycle before
+    another object is written (and optionally read). This is required when the
+    catch-up object uses the content of the other object, such as the PPU with
+    the VRAM: each write must happen after all the previous cycles of the PPU
+    were performed.
+
+    @param accessed Bus_obj* object whose access requires synchronization
+    @param synced Bus_obj* catch-up object to synchronize
+    @param on_read bool true if reads also require synchronization
+
+*/
+void Bus::add_sync_dependency(Bus_obj* accessed, Bus_obj* synced, bool on_read){
+
+  if(!synced->is_catch_up())
+    throw std::invalid_argument("Object " + synced->name + " is not a catch-up object");
+
+  uint32_t accessed_index = get_object_index(accessed);
+  uint32_t synced_index = get_object_index(synced);
+
+  write_sync[accessed_index].push_back(synced_index);
+  if(on_read) read_sync[accessed_index].push_back(synced_index);
+}
+
+/** Bus::catch_up_object
+    Run all the steps a catch-up object is late of, and update the
+    countdown to its next event
+
+    @param index uint32_t index of the object
+
+*/
+void Bus::catch_up_object(uint32_t index){
+
+  uint32_t cycles = pending_cycles[index];
+
+  // The pending cycles are reset before running, so that accesses performed
+  // by the object itself do not run it again
+  if(cycles != 0){
+    pending_cycles[index] = 0;
+    PROFILER_BEGIN(profiler, index);
+    bus_objects[index]->run(this, cycles);
+    PROFILER_END(profiler, 1, cycles);
+  }
+
+  event_countdown[index] = bus_objects[index]->get_cycles_to_event();
 }
 
+/** Bus::catch_up_object
+    Run a catch-up object up to the current cycle, when it must observe an
+    event raised by another object
+
+    @param object Bus_obj* object to run
+
+*/
+void Bus::catch_up_object(Bus_obj* object){
+  catch_up_object(get_object_index(object));
+}
 
 /** Bus::read
     Read by from memory at a given address.
-    Try all the objects connected to the bus.
+    IO registers are found in the IO table, for the
+    other addresses try all the objects connected to the bus.
 
     @param addr uint16_t address to read
     @return uint8_t read byte
@@ -84,6 +222,16 @@ uint8_t Bus::read(uint16_t addr){
   uint16_t size;
   uint16_t init_addr;
 
+  // IO registers are found in the table
+  if(addr >= IO_TABLE_INIT_ADDR and addr < IO_TABLE_INIT_ADDR + IO_TABLE_SIZE){
+    Io_handler& io = io_table[addr - IO_TABLE_INIT_ADDR];
+    if(io.obj == nullptr) return 0xff;
+
+    PROFILER_COUNT_READ(profiler, io.index);
+    for(auto synced : read_sync[io.index]) catch_up_object(synced);
+    return io.read(io.obj, io.offset) | io.read_mask;
+  }
+
   for(uint32_t i = 0; i < bus_objects.size(); i++){
 
     size = size_cache[i];
@@ -92,8 +240,11 @@ uint8_t Bus::read(uint16_t addr){
     // Cannot read on non-addressable objects
     if(size == 0) continue;
 
-    if(addr >= init_addr && addr < init_addr + size)
+    if(addr >= init_addr && addr < init_addr + size){
+      PROFILER_COUNT_READ(profiler, i);
+      for(auto synced : read_sync[i]) catch_up_object(synced);
       return bus_objects[i]->read(addr - init_addr);
+    }
   }
 
   return 0xff;
@@ -101,7 +252,8 @@ uint8_t Bus::read(uint16_t addr){
 
 /** Bus::write
     Write a byte in memory at a given address.
-    Try with all the object connected to the bus.
+    IO registers are found in the IO table, for the
+    other addresses try with all the object connected to the bus.
 
     @param addr uint16_t address to use
     @param data uint8_t  byte to write
@@ -112,6 +264,20 @@ void Bus::write(uint16_t addr, uint8_t data){
   uint16_t size;
   uint16_t init_addr;
 
+  // IO registers are found in the table
+  if(addr >= IO_TABLE_INIT_ADDR and addr < IO_TABLE_INIT_ADDR + IO_TABLE_SIZE){
+    Io_handler& io = io_table[addr - IO_TABLE_INIT_ADDR];
+    if(io.obj == nullptr) return;
+
+    PROFILER_COUNT_WRITE(profiler, io.index);
+    for(auto synced : write_sync[io.index]) catch_up_object(synced);
+    io.write(io.obj, io.offset, data);
+
+    // The write might have moved the next event of the synchronized objects
+    for(auto synced : write_sync[io.index]) event_countdown[synced] = bus_objects[synced]->get_cycles_to_event();
+    return;
+  }
+
   for(uint32_t i = 0; i < bus_objects.size(); i++){
 
     size = size_cache[i];
@@ -121,13 +287,63 @@ void Bus::write(uint16_t addr, uint8_t data){
     if(size == 0) continue;
 
     if(addr >= init_addr && addr < init_addr + size){
+      PROFILER_COUNT_WRITE(profiler, i);
+      for(auto synced : write_sync[i]) catch_up_object(synced);
       bus_objects[i]->write(addr - init_addr, data);
+
+      // The write might have moved the next event of the synchronized objects
+      for(auto synced : write_sync[i]) event_countdown[synced] = bus_objects[synced]->get_cycles_to_event();
       return;
     }
   }
 
 }
 
+/** Bus::get_memory_pointer
+    Find the object containing a range of addresses, and return the pointer
+    to its memory provided by the object itself. The range cannot span over
+    more than one object
+
+    @param addr uint16_t first address of the range
+    @param size uint16_t number of bytes of the range
+    @return const uint8_t* pointer to the first byte, nullptr if not available
+
+*/
+const uint8_t* Bus::get_memory_pointer(uint16_t addr, uint16_t size){
+
+  uint16_t obj_size;
+  uint16_t init_addr;
+
+  for(uint32_t i = 0; i < bus_objects.size(); i++){
+
+    obj_size = size_cache[i];
+    init_addr = init_addr_cache[i];
+
+    // Cannot read on non-addressable objects
+    if(obj_size == 0) continue;
+
+    if(addr >= init_addr && addr < init_addr + obj_size){
+      if(addr + size > init_addr + obj_size) return nullptr;
+      for(auto synced : read_sync[i]) catch_up_object(synced);
+      return bus_objects[i]->get_memory_pointer(addr - init_addr, size);
+    }
+  }
+
+  return nullptr;
+}
+
+/** Bus::set_profiler
+    Provide the profiler measuring the objects, which are identified by
+    their position on the bus. All the objects must be already attached
+
+    @param profiler Profiler* profiler to use, nullptr to stop profiling
+
+*/
+void Bus::set_profiler(Profiler* profiler){
+  this->profiler = profiler;
+  if(profiler != nullptr) for(auto obj : bus_objects) profiler->add_component(obj->name);
+}
+
 /** Bus::step
 
     @param bus Bus_obj* pointer to the bus to use to perform reading from the elements side
@@ -138,10 +354,6 @@ void Bus::step(Bus_obj* bus){
   uint32_t bus_frequency = this->frequency;
   uint32_t obj_frequency;
 
-  // Reset current tick
-  if(current_cycles_counting == 0)
-    initial_tick_frame = SDL_GetTicks();
-
   for(uint32_t i = 0; i < bus_objects.size(); i++){
 
     // In single speed mode, the frequency is stored in the `frequency_cache` array,
@@ -154,13 +366,27 @@ void Bus::step(Bus_obj* bus){
     // Cannot step asynchronous objects, such as memories
     if(obj_frequency == 0) continue;
 
+    // Catch-up objects only accumulate their steps, until the next event is due
+    if(catch_up_cache[i]){
+      for(uint32_t j = 0; j < BUS_STEP_SIZE; j++){
+        if((current_cc + j) % (bus_frequency / obj_frequency) == 0)
+          pending_cycles[i]++;
+      }
+      if(pending_cycles[i] >= event_countdown[i]) catch_up_object(i);
+      continue;
+    }
+
     // Try the next 4 T-cycles and possibly perform all the steps.
     // This is a way to lose a bit of timing accuracy, while gaining
     // performances in the emulator
+    uint32_t steps = 0;
     for(uint32_t j = 0; j < BUS_STEP_SIZE; j++){
-      if((current_cc + j) % (bus_frequency / obj_frequency) == 0)
+      if((current_cc + j) % (bus_frequency / obj_frequency) == 0){
+        if(steps++ == 0){ PROFILER_BEGIN(profiler, i); }
         bus_objects[i]->step(bus);
+      }
     }
+    if(steps != 0){ PROFILER_END(profiler, steps, steps); }
 
   }
 
@@ -6,11 +6,12 @@
 #include <iostream>
 #include <vector>
 #include "bus_obj.h"
+#include "io_handler.h"
+#include "../utils/profiler.h"
 #include "../PPU/PPU_def.h"
 #include "../utils/gb_global_t.h"
 
 #define BUS_STEP_SIZE 4
-#define FPS 60
 
 class Bus : public Bus_obj{
 
@@ -34,15 +35,32 @@ class Bus : public Bus_obj{
   std::vector<uint32_t> frequency_cache;
   std::vector<uint32_t> init_addr_cache;
   std::vector<uint32_t> size_cache;
+  std::vector<uint8_t>  catch_up_cache;
+
+  /*
+   * Catch-up objects are not stepped at each cycle: the bus counts the
+   * steps they are late of, and runs them all at once either when their next
+   * event is due, or when the rest of the system accesses them (or any object
+   * whose content they depend on). Once they are run, the bus asks them how
+   * many steps are left to their next event.
+   * */
+  std::vector<uint32_t> pending_cycles;
+  std::vector<uint32_t> event_countdown;
+
+  // For each object, the catch-up objects to run before it is read or written
+  std::vector<std::vector<uint32_t>> read_sync;
+  std::vector<std::vector<uint32_t>> write_sync;
+
+  // Handlers of the IO registers, filled when the objects are added to the bus
+  Io_handler io_table[IO_TABLE_SIZE];
+
+  uint32_t get_object_index(Bus_obj*);
 
   // Takes care of couting the current clock cycle.
   uint32_t current_cc;
 
-  // How many cycles have been passed since last frame randered
-  uint32_t current_cycles_counting;
-
-  // Last initial SDL tick since new frame was rendered
-  uint32_t initial_tick_frame;
+  // Optional profiling of the objects, compiled only with __PROFILER
+  Profiler* profiler;
 
 public:
 
@@ -54,9 +72,25 @@ public:
   // Perform a write operation
   void write(uint16_t, uint8_t);
 
+  // Resolve a range of addresses to the memory of the object containing it
+  const uint8_t* get_memory_pointer(uint16_t, uint16_t);
+
   // Add element to the bus
   void add_to_bus(Bus_obj*);
 
+  // Replace the handlers of an IO register
+  void set_io_handler(uint16_t, Io_read_handler, Io_write_handler, uint8_t);
+
+  // Run a catch-up object before another object is accessed
+  void add_sync_dependency(Bus_obj*, Bus_obj*, bool);
+
+  // Run a catch-up object up to the current cycle
+  void catch_up_object(uint32_t);
+  void catch_up_object(Bus_obj*);
+
+  // Profile the objects attached so far
+  void set_profiler(Profiler*);
+
   // Step for all the attached elements
   void step(Bus_obj*);
 
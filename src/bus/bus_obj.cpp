@@ -10,6 +10,7 @@
 */
 Bus_obj::Bus_obj(std::string name, uint16_t init_addr, uint16_t size_addr){
   this->frequency = 0;
+  this->catch_up = false;
   this->name = name;
   this->init_addr = init_addr;
   this->size_addr = size_addr;
@@ -66,4 +67,50 @@ uint16_t Bus_obj::get_last_addr(){
   return this->last_addr;
 }
 
+/** Bus_obj::is_catch_up
+    Return whether the object is stepped lazily by the bus
 
+    @return bool true for catch-up objects
+
+*/
+bool Bus_obj::is_catch_up(){
+  return this->catch_up;
+}
+
+/** Bus_obj::run
+    Perform several steps at once. Catch-up objects override this method
+    to advance their state in bulk
+
+    @param bus Bus_obj* pointer to the bus to use for reading
+    @param cycles uint32_t number of steps to perform
+
+*/
+void Bus_obj::run(Bus_obj* bus, uint32_t cycles){
+  for(uint32_t i = 0; i < cycles; i++) step(bus);
+}
+
+/** Bus_obj::get_cycles_to_event
+    Return in how many steps the object will have an effect which must be
+    visible to the rest of the system (an interrupt, a write on the bus...).
+    A catch-up object is run by the bus at the latest on that step
+
+    @return uint32_t number of steps to the next event, at least 1
+
+*/
+uint32_t Bus_obj::get_cycles_to_event(){
+  return 1;
+}
+
+/** Bus_obj::get_memory_pointer
+    Return a pointer to the memory backing a range of addresses, so that it
+    can be copied without going through `read` for each byte. Objects whose
+    content is not plain memory return nullptr, and must be read byte by byte
+
+    @param addr uint16_t first address of the range, relative to the object
+    @param size uint16_t number of bytes of the range
+    @return const uint8_t* pointer to the first byte, nullptr if not available
+
+*/
+const uint8_t* Bus_obj::get_memory_pointer(uint16_t, uint16_t){
+  return nullptr;
+}
@@ -15,6 +15,10 @@ protected:
 
   uint32_t frequency;
 
+  // Objects which are not stepped at each cycle, but only when an event
+  // is due or when they are accessed through the bus
+  bool catch_up;
+
 public:
   std::string name;
 
@@ -24,9 +28,13 @@ public:
   uint16_t get_last_addr();
   void     set_frequency(uint32_t);
   uint32_t get_frequency();
+  bool     is_catch_up();
   virtual uint8_t read(uint16_t) = 0;
   virtual void write(uint16_t, uint8_t) = 0;
   virtual void step(Bus_obj*) = 0;
+  virtual void run(Bus_obj*, uint32_t);
+  virtual uint32_t get_cycles_to_event();
+  virtual const uint8_t* get_memory_pointer(uint16_t, uint16_t);
   virtual ~Bus_obj() {};
 
 };
@@ -0,0 +1,60 @@
+#ifndef __IO_HANDLER_H
+#define __IO_HANDLER_H
+
+#include <cstdint>
+#include "bus_obj.h"
+
+// The IO registers at 0xFF00-0xFF7F are dispatched through a table
+// indexed by the low bits of the address
+#define IO_TABLE_INIT_ADDR 0xFF00
+#define IO_TABLE_SIZE      0x80
+
+// Handlers of an IO register, receiving the object which owns it and
+// the address of the register relative to the object
+typedef uint8_t (*Io_read_handler)(Bus_obj*, uint16_t);
+typedef void    (*Io_write_handler)(Bus_obj*, uint16_t, uint8_t);
+
+/*
+ * Entry of the IO table. By default the handlers go through the `read` and
+ * `write` methods of the object, but the objects can replace them with
+ * handlers accessing the register directly. The bits set in `read_mask`
+ * are not implemented in the register, and they are always read as 1.
+ * */
+struct Io_handler {
+  Bus_obj*         obj;
+  uint32_t         index;
+  uint16_t         offset;
+  Io_read_handler  read;
+  Io_write_handler write;
+  uint8_t          read_mask;
+};
+
+uint8_t io_read_object(Bus_obj*, uint16_t);
+void    io_write_object(Bus_obj*, uint16_t, uint8_t);
+
+/** io_read_register
+    Read handler of a register stored as a plain member of the object
+
+    @param obj Bus_obj* object owning the register
+    @return uint8_t value of the register
+
+*/
+template<class T, uint8_t T::*reg>
+uint8_t io_read_register(Bus_obj* obj, uint16_t){
+  return static_cast<T*>(obj)->*reg;
+}
+
+/** io_write_register
+    Write handler of a register stored as a plain member of the object,
+    whose writes have no other effect
+
+    @param obj Bus_obj* object owning the register
+    @param data uint8_t byte to write
+
+*/
+template<class T, uint8_t T::*reg>
+void io_write_register(Bus_obj* obj, uint16_t, uint8_t data){
+  static_cast<T*>(obj)->*reg = data;
+}
+
+#endif // !__IO_HANDLER_H
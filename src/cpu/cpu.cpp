@@ -11,6 +11,7 @@ extern struct gb_global_t gb_global;
 Cpu::Cpu(std::string name, uint32_t frequency) : Bus_obj(name, 0, 0){
 
   this->set_frequency(frequency);
+  this->hdma = nullptr;
 
   _state = State::STATE_1;
 
@@ -31,6 +32,7 @@ Cpu::Cpu(std::string name, uint32_t frequency) : Bus_obj(name, 0, 0){
   _ei_delayed = 0;
   _is_halted = 0;
   _halt_bug = 0;
+  _instructions = 0;
 
 }
 
@@ -58,7 +60,7 @@ void Cpu::step(Bus_obj* bus){
 
   // The CPU cannot do anything if an HRAM transfer is being done. This is
   // indicated by the MSB of HDMA5 being 0.
-  if(gb_global.gbc_mode == 1 and !(bus->read(MMU_HDMA5_ADDR) & 0x80)) return;
+  if(hdma != nullptr and hdma->is_stalling_cpu()) return;
 
   // Handle switch mode. The cpu needs to wait 2050 M-cycle in the previous
   // speed before effectively switching. Once the cycles have passed, the
@@ -98,6 +100,9 @@ void Cpu::step(Bus_obj* bus){
 
     _opcode = fetch(bus);
 
+    // While halted, the HALT instruction is fetched again at each M-cycle
+    if(!_is_halted) _instructions++;
+
     if(_halt_bug == 1){
       registers.PC--;
       _halt_bug = 0;
@@ -6,6 +6,7 @@
 #include "../memory/memory_map.h"
 #include "../bus/bus.h"
 #include "../bus/bus_obj.h"
+#include "../IO/HDMA.h"
 #include "../utils/gb_global_t.h"
 #include <stdexcept>
 #include <stdio.h>
@@ -49,6 +50,9 @@ class Cpu : public Bus_obj{
   uint8_t    _interrupt_to_handle;
   uint16_t   _stop_cycles_to_wait;
 
+  // Instructions executed so far, for benchmarking
+  uint64_t   _instructions;
+
   // Fetch function
   uint8_t fetch(Bus_obj*);
 
@@ -92,6 +96,9 @@ class Cpu : public Bus_obj{
 
 public:
 
+  // HDMA which can stall the CPU, only in CGB mode
+  HDMA* hdma;
+
   // Constructor
   Cpu(std::string, uint32_t);
 
@@ -105,6 +112,9 @@ public:
   // Get all the registers (debug purposes)
   Registers get_registers();
 
+  // Get the number of instructions executed
+  uint64_t get_instructions();
+
 };
 
 #endif // __CPU_H
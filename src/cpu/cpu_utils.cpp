@@ -85,6 +85,17 @@ Registers Cpu::get_registers(){
   return registers;
 }
 
+/** CPU::get_instructions
+    Return the number of instructions executed so far. The cycles spent
+    in halt mode are not counted as instructions
+
+    @return uint64_t number of instructions
+
+*/
+uint64_t Cpu::get_instructions(){
+  return _instructions;
+}
+
 /** CPU::read_x8
     The following operation is performed:
       if index is 0, return the value of B
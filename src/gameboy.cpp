@@ -11,11 +11,19 @@ struct gb_global_t gb_global;
     be connected to the main bus; it sets the addresses with the respect to the mmu
     configuration; it uses the input file to initialize the cartridge
 
-    @param name std::string Path to the rom file to use
-    @param fixed_fps uint8_t Decides whether the FPS should be set to 60 or not
+    @param args gb_cli_args_t Options provided by the user (rom file, fps, headless mode...)
 
 */
-Gameboy::Gameboy(std::string rom_file, uint8_t fixed_fps){
+Gameboy::Gameboy(gb_cli_args_t args){
+
+  // Headless mode must be known before the SDL components are created
+  gb_global.headless = args.headless;
+  gb_global.sample_rate = args.sample_rate;
+  gb_global.audio_latency = args.audio_latency;
+
+  // The APU only produces audio when the emulation is paced at real time
+  gb_global.fixed_fps = args.fixed_fps;
+  gb_global.speed = args.speed;
 
   // Create bus
   this->bus = new Bus("BUS", 0, 0xFFFF, BUS_FREQUENCY);
@@ -23,7 +31,9 @@ Gameboy::Gameboy(std::string rom_file, uint8_t fixed_fps){
   // Initialize cartridge and set cgb mode. This is important for the initialization of
   // registers in the different components
   this->cart = new Cartridge(     "CART",       MMU_CART_INIT_ADDR,       MMU_CART_SIZE                             );
-  this->cart->init_from_file(rom_file);
+  this->cart->set_save_enabled(!args.no_save);
+  this->cart->set_save_mapped(args.mmap_save);
+  this->cart->init_from_file(args.rom_file_name);
 
   // Create all the components to be attached to the bus
   this->wram = new WRAM(          "WRAM",       MMU_WRAM_INIT_ADDR,       MMU_WRAM_SIZE                             );
@@ -73,10 +83,44 @@ Gameboy::Gameboy(std::string rom_file, uint8_t fixed_fps){
   this->bus->add_to_bus(this->vbk_reg);
   this->bus->add_to_bus(this->cpu);
 
-  // Add reference to the bus for specific components which
-  // require out-of-step reading/writing
-  this->cart->_bus_to_read = bus;
-  this->wram->_bus_to_read = bus;
+  // The registers of the most accessed peripherals are read and written
+  // directly by the bus, through its IO table
+  this->ppu->set_io_handlers(this->bus);
+  this->apu->set_io_handlers(this->bus);
+  this->timer->set_io_handlers(this->bus);
+  this->serial->set_io_handlers(this->bus);
+
+  // The PPU is run lazily by the bus, thus it must be brought up to date
+  // before anything it renders from is modified: VRAM (in the cartridge),
+  // OAM and CRAM
+  this->bus->add_sync_dependency(this->cart, this->ppu, false);
+  this->bus->add_sync_dependency(this->oam,  this->ppu, false);
+  this->bus->add_sync_dependency(this->cram, this->ppu, false);
+
+  // The APU is also run lazily. Its frame sequencer is stepped by the timer
+  // on DIV falling edges, so it must be up to date before DIV is reset
+  this->bus->add_sync_dependency(this->timer, this->apu, false);
+  this->timer->apu = this->apu;
+  this->timer->_bus_to_sync = this->bus;
+
+  // The HDMA copies straight into the VRAM, after bringing the PPU up to date,
+  // and it is notified by the PPU when HBLANK starts. The CPU checks directly
+  // whether it is stalled by a transfer. All of this only applies in CGB mode
+  this->hdma->cart = this->cart;
+  this->hdma->ppu = this->ppu;
+  this->hdma->_bus_to_sync = this->bus;
+  if(gb_global.gbc_mode){
+    this->bus->add_sync_dependency(this->hdma, this->ppu, false);
+    this->ppu->hdma = this->hdma;
+    this->cpu->hdma = this->hdma;
+  }
+
+  // The memories cache the banks selected by VBK and SVBK, instead of
+  // reading the registers through the bus at each access. The cartridge
+  // also unmaps the boot rom once BROM_EN is written
+  this->vbk_reg->add_listener(this->cart);
+  this->brom_en->add_listener(this->cart);
+  this->svbk_reg->add_listener(this->wram);
 
   // The ppu requires to access the VRAM directly, independently from the current
   // VRAM bank selected (GBC mode). For this reason, it cannot read from the bus,
@@ -92,6 +136,9 @@ Gameboy::Gameboy(std::string rom_file, uint8_t fixed_fps){
   // In a realistic implementation, the CRAM is part of the PPU.
   this->ppu->cram = this->cram;
 
+  // The OAM DMA copies the objects straight into the OAM memory
+  this->ppu->oam = this->oam;
+
   // Max volume on start-up
   gb_global.volume_amplification  = JOYPAD_MAX_VOLUME;
 
@@ -101,19 +148,233 @@ Gameboy::Gameboy(std::string rom_file, uint8_t fixed_fps){
   // No double-speed mode
   gb_global.double_speed          = 0;
 
-  // Fixed fps (delay inside APU)
-  gb_global.fixed_fps             = fixed_fps;
+  // No frame is ready yet
+  gb_global.frame_ready           = 0;
+
+  // Frame counting and optional recording
+  this->frame_counter = 0;
+  this->max_frames = args.max_frames;
+  this->boot_only = false;
+  this->cycles = 0;
+  this->capture = nullptr;
+  if(args.capture_file_name != "")
+    this->capture = new Video_capture(args.capture_file_name, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+  // Stems are named after the main file: out.wav -> out_ch1.wav ... out_ch4.wav
+  this->audio_capture = nullptr;
+  for(int i = 0; i < APU_CHANNELS; i++) this->audio_stems[i] = nullptr;
+  if(args.audio_file_name != ""){
+    this->audio_capture = new Audio_capture(args.audio_file_name, this->apu->get_sample_rate(), 2);
+    this->apu->set_audio_capture(this->audio_capture);
+
+    std::string stem_name = args.audio_file_name;
+    size_t extension = stem_name.rfind(".wav");
+    if(extension != std::string::npos and extension == stem_name.size() - 4) stem_name.resize(extension);
+
+    for(int i = 0; args.audio_stems and i < APU_CHANNELS; i++){
+      this->audio_stems[i] = new Audio_capture(stem_name + "_ch" + std::to_string(i + 1) + ".wav", this->apu->get_sample_rate(), 2);
+      this->apu->set_stem_capture(i, this->audio_stems[i]);
+    }
+  }
+  this->input_script = nullptr;
+  if(args.input_file_name != "")
+    this->input_script = new Input_script(args.input_file_name);
+  this->hasher = nullptr;
+  if(args.hash_file_name != "")
+    this->hasher = new Frame_hasher(args.hash_file_name, args.hash_record);
+  this->frame_timer = new Frame_timer(GAMEBOY_PACING_FREQUENCY, args.speed, args.fixed_fps);
+  this->profiler = nullptr;
+  if(args.profile_file_name != ""){
+    this->profiler = new Profiler(args.profile_file_name);
+    this->bus->set_profiler(this->profiler);
+  }
+
+  // Without hardware counters the emulation continues, only the warning is shown
+  this->perf = nullptr;
+  if(args.perf_file_name != ""){
+    this->perf = new Perf_counters(args.perf_file_name);
+    if(!this->perf->is_available()){
+      delete this->perf;
+      this->perf = nullptr;
+    }
+    else if(this->profiler) this->profiler->set_counters(this->perf);
+  }
+
+  this->stats = nullptr;
+  if(args.stats_socket_name != "")
+    this->stats = new Stats_server(args.stats_socket_name);
+
+  // Keys for the first frame
+  std::vector<uint8_t> keys;
+  if(this->input_script and this->input_script->get_keys(0, keys))
+    this->joypad->set_scripted_keys(keys);
 }
 
 /** Gameboy::run
     Runs the gameboy by stepping the bus
 
+    @return int 0 if the execution completed, GAMEBOY_DIVERGED if a frame
+                did not match the hash baseline
+
+*/
+int Gameboy::run(){
+
+  run_loop();
+
+  // Glitches of the audio output, useful to tune --audio_latency
+  if(this->apu->get_audio_underruns() or this->apu->get_audio_overruns()){
+    std::cerr << "Audio underruns: " << this->apu->get_audio_underruns()
+              << ", overruns: " << this->apu->get_audio_overruns() << std::endl;
+  }
+
+  if(this->hasher) this->hasher->finish();
+
+  if(this->hasher and this->hasher->has_diverged()){
+    std::cerr << "First diverging frame: " << this->hasher->get_diverging_frame()
+              << " (" << this->hasher->get_divergence() << ")" << std::endl;
+    return GAMEBOY_DIVERGED;
+  }
+
+  return 0;
+}
+
+/** Gameboy::run_boot
+    Runs the gameboy until the boot rom is unmapped, at the end of the frame
+    in which it happens. The frame limit then counts the frames after the boot,
+    so that a benchmark only measures the program of the cartridge
+
+*/
+void Gameboy::run_boot(){
+
+  uint32_t frames_after_boot = this->max_frames;
+
+  this->max_frames = 0;
+  this->boot_only = true;
+  run_loop();
+  this->boot_only = false;
+
+  // Only the end of the boot is consumed, not a request of the user
+  if(!this->cart->is_boot_rom_mapped()) gb_global.exit_request = 0;
+  if(frames_after_boot != 0) this->max_frames = this->frame_counter + frames_after_boot;
+}
+
+/** Gameboy::run_loop
+    Steps the bus until an exit is requested, completing the frames
+
 */
-void Gameboy::run(){
+void Gameboy::run_loop(){
+
+  uint32_t steps = 0;
+
   while(1){
     this->bus->step(bus);
+    steps++;
+
+    if(gb_global.frame_ready){
+      this->frame_timer->advance(steps * BUS_STEP_SIZE);
+      this->cycles += steps * BUS_STEP_SIZE;
+      steps = 0;
+      end_of_frame();
+    }
+
     if(gb_global.exit_request) break;
+
+    // Pacing is done on the bus clock, so that it also works while the LCD is off
+    if(steps == GAMEBOY_PACING_STEPS){
+      this->frame_timer->advance(steps * BUS_STEP_SIZE);
+      this->cycles += steps * BUS_STEP_SIZE;
+      steps = 0;
+    }
+  }
+}
+
+/** Gameboy::end_of_frame
+    Operations to be performed once the PPU has completed a frame:
+    the frame is recorded (if required) and the frame limit is checked
+
+*/
+void Gameboy::end_of_frame(){
+
+  gb_global.frame_ready = 0;
+  this->frame_counter++;
+  this->frame_timer->end_frame();
+  this->cart->flush_save_data_ram();
+  if(this->profiler) this->profiler->end_frame();
+  if(this->perf) this->perf->end_frame();
+
+  // The PPU completed the frame in its VBLANK step: the state is published
+  // for the live statistics, with the timing measured by the frame timer
+  if(this->stats){
+    Save_writer* save_writer = this->cart->get_save_writer();
+    this->stats->end_frame({
+      this->frame_timer->get_frame_time_ns(),
+      this->frame_timer->get_fps(),
+      this->frame_timer->get_speed(),
+      this->apu->get_audio_underruns(),
+      this->apu->get_audio_overruns(),
+      save_writer ? save_writer->get_writes() : 0,
+      save_writer ? save_writer->get_last_latency_ns() : 0,
+      save_writer ? save_writer->get_max_latency_ns() : 0
+    });
   }
+
+  if(this->capture) this->capture->push_frame(this->ppu->get_display_matrix());
+
+  if(this->hasher){
+    uint64_t frame_hash = gb_hash64(this->ppu->get_display_matrix(), SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(uint32_t));
+    this->hasher->push_frame(this->frame_counter, frame_hash, get_state_hash());
+  }
+
+  // Keys are changed between two frames, as the frame counter is the only clock of the script
+  std::vector<uint8_t> keys;
+  if(this->input_script and this->input_script->get_keys(this->frame_counter, keys))
+    this->joypad->set_scripted_keys(keys);
+
+  if(this->max_frames != 0 and this->frame_counter >= this->max_frames)
+    gb_global.exit_request = 1;
+
+  if(this->boot_only and !this->cart->is_boot_rom_mapped())
+    gb_global.exit_request = 1;
+}
+
+/** Gameboy::get_frames
+    @return uint32_t number of frames rendered so far
+
+*/
+uint32_t Gameboy::get_frames(){
+  return this->frame_counter;
+}
+
+/** Gameboy::get_cycles
+    @return uint64_t number of bus cycles emulated so far (BUS_FREQUENCY per second)
+
+*/
+uint64_t Gameboy::get_cycles(){
+  return this->cycles;
+}
+
+/** Gameboy::get_instructions
+    @return uint64_t number of instructions executed by the CPU so far
+
+*/
+uint64_t Gameboy::get_instructions(){
+  return this->cpu->get_instructions();
+}
+
+/** Gameboy::get_state_hash
+    Hash of the memories of the gameboy: cartridge (ram, vram and banking),
+    working ram, oam, high ram and color ram
+
+    @return uint64_t hash of the state
+
+*/
+uint64_t Gameboy::get_state_hash(){
+  uint64_t hash = GB_HASH_SEED;
+  hash = this->cart->get_state_hash(hash);
+  hash = this->wram->get_state_hash(hash);
+  hash = this->oam->get_state_hash(hash);
+  hash = this->hram->get_state_hash(hash);
+  return this->cram->get_state_hash(hash);
 }
 
 /** Gameboy::~Gameboy
@@ -121,6 +382,15 @@ void Gameboy::run(){
 
 */
 Gameboy::~Gameboy(){
+  delete this->capture;
+  delete this->audio_capture;
+  for(int i = 0; i < APU_CHANNELS; i++) delete this->audio_stems[i];
+  delete this->input_script;
+  delete this->hasher;
+  delete this->frame_timer;
+  delete this->profiler;
+  delete this->perf;
+  delete this->stats;
   delete this->bus;
   delete this->cart;
   delete this->wram;
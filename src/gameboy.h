@@ -15,6 +15,16 @@
 #include "memory/CRAM.h"
 #include "PPU/PPU.h"
 #include "utils/gb_global_t.h"
+#include "utils/cli_parser.h"
+#include "utils/video_capture.h"
+#include "utils/audio_capture.h"
+#include "utils/input_script.h"
+#include "utils/frame_hasher.h"
+#include "utils/hash.h"
+#include "utils/frame_timer.h"
+#include "utils/profiler.h"
+#include "utils/perf_counters.h"
+#include "utils/stats_server.h"
 #include <string>
 
 #define BUS_FREQUENCY     8388608
@@ -25,6 +35,16 @@
 #define SERIAL_FREQUENCY  1
 #define JOYPAD_FREQUENCY  1024
 
+// Maximum bus steps between two checks of the pacer (about 1 ms)
+#define GAMEBOY_PACING_STEPS 2048
+
+// Bus cycles per second of real time. The APU T-cycles are played at APU_BUS_FREQUENCY
+// per second (which gives ~59.7 fps), and the pacer must keep the same speed
+#define GAMEBOY_PACING_FREQUENCY (APU_BUS_FREQUENCY * (BUS_FREQUENCY / (APU_FREQUENCY)))
+
+// Exit status when a frame does not match the hash baseline
+#define GAMEBOY_DIVERGED  2
+
 class Gameboy{
 
   Bus*        bus;
@@ -47,10 +67,48 @@ class Gameboy{
   Register*   vbk_reg;
   Cpu*        cpu;
 
+  // Optional recording of the frames
+  Video_capture* capture;
+
+  // Optional recording of the audio output, and of each channel
+  Audio_capture* audio_capture;
+  Audio_capture* audio_stems[APU_CHANNELS];
+
+  // Optional scripted input and frame hashing
+  Input_script*  input_script;
+  Frame_hasher*  hasher;
+
+  // Pacing at real time (when fps are fixed) and FPS measurement
+  Frame_timer*   frame_timer;
+
+  // Optional profiling of the components
+  Profiler*      profiler;
+  Perf_counters* perf;
+  Stats_server*  stats;
+
+  // Number of frames rendered so far, and number of frames after
+  // which the emulation stops (0 for no limit)
+  uint32_t    frame_counter;
+  uint32_t    max_frames;
+
+  // Set while running only until the boot rom completes
+  bool        boot_only;
+
+  // Bus cycles emulated so far
+  uint64_t    cycles;
+
+  void     run_loop();
+  void     end_of_frame();
+  uint64_t get_state_hash();
+
 public:
 
-  Gameboy(std::string, uint8_t);
-  void run();
+  Gameboy(gb_cli_args_t);
+  int  run();
+  void run_boot();
+  uint32_t get_frames();
+  uint64_t get_cycles();
+  uint64_t get_instructions();
   ~Gameboy();
 };
 
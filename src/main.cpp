@@ -4,7 +4,7 @@
 int main(int argc, char* argv[]){
 
   gb_cli_args_t args = parse_gb_args(argc, argv);
-  Gameboy gb(args.rom_file_name, args.fixed_fps);
+  Gameboy gb(args);
 
-  gb.run();
+  return gb.run();
 }
@@ -1,4 +1,5 @@
 #include "CRAM.h"
+#include "../utils/hash.h"
 
 /** CRAM::read
     Read by from CRAM at a given address
@@ -128,3 +129,14 @@ uint32_t CRAM::read_color_palette(uint8_t target, uint8_t palette_number, uint8_
   return (red << 16) | (green << 8) | blue;
 }
 
+/** CRAM::get_state_hash
+    Hash of the content of both the palettes
+
+    @param seed uint64_t hash to chain with
+    @return uint64_t resulting hash
+
+*/
+uint64_t CRAM::get_state_hash(uint64_t seed){
+  seed = gb_hash64(background_palette.data(), background_palette.size(), seed);
+  return gb_hash64(object_palette.data(), object_palette.size(), seed);
+}
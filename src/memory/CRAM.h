@@ -27,6 +27,7 @@ public:
   void      write(uint16_t, uint8_t);
   void      step(Bus_obj*){}
   uint32_t  read_color_palette(uint8_t, uint8_t, uint8_t);
+  uint64_t  get_state_hash(uint64_t);
             ~CRAM(){}
 };
 
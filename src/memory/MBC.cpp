@@ -1,5 +1,108 @@
 #include "cartridge.h"
 
+/** Cartridge::rom_bank
+    @param bank uint32_t index of a ROM bank, wrapped on the number of banks
+    @return const uint8_t* pointer to the first byte of the bank
+
+*/
+const uint8_t* Cartridge::rom_bank(uint32_t bank){
+  return _rom_data + (bank % _rom_bank_size) * ROM_SIZE;
+}
+
+/** Cartridge::ram_bank
+    @param bank uint32_t index of a RAM bank, wrapped on the number of banks
+    @return uint8_t* pointer to the first byte of the bank
+
+*/
+uint8_t* Cartridge::ram_bank(uint32_t bank){
+  return _ram_data + (bank % _ram_bank_size) * RAM_SIZE;
+}
+
+/** Cartridge::mark_ram_dirty
+    Flag the page of RAM containing a written address of the mapped bank
+
+    @param addr uint16_t written address, in 0xA000-0xBFFF
+
+*/
+void Cartridge::mark_ram_dirty(uint16_t addr){
+  size_t offset = (_sram_ptr - _ram_data) + (addr - RAM_BNN_INIT_ADDR);
+  _ram_dirty_pages[offset / SAVE_WRITER_PAGE_SIZE] = 1;
+  _ram_dirty = true;
+}
+
+/** Cartridge::mapped_read
+    Read handler of a type of cartridge: the VRAM, which shares the address
+    space of the cartridge, is handled here, the rest by the MBC. The MBC
+    function is a template parameter, so that no dispatch is left at runtime
+
+    @param addr uint16_t address to read
+    @return uint8_t read byte
+*/
+template<Cartridge_read_handler mbc_read>
+uint8_t Cartridge::mapped_read(uint16_t addr){
+  if(addr >= VRAM_INIT_ADDR and addr < VRAM_END_ADDR) return _vram_ptr[addr - VRAM_INIT_ADDR];
+  return (this->*mbc_read)(addr);
+}
+
+/** Cartridge::mapped_write
+    Write handler of a type of cartridge, see `mapped_read`
+
+    @param addr uint16_t address to use
+    @param data uint8_t  byte to write
+*/
+template<Cartridge_write_handler mbc_write>
+void Cartridge::mapped_write(uint16_t addr, uint8_t data){
+  if(addr >= VRAM_INIT_ADDR and addr < VRAM_END_ADDR){
+    _vram_ptr[addr - VRAM_INIT_ADDR] = data;
+    return;
+  }
+  (this->*mbc_write)(addr, data);
+}
+
+/** Cartridge::select_handlers
+    Choose the handlers of the accesses for the type of cartridge read from
+    the header, and map its initial banks
+
+*/
+void Cartridge::select_handlers(){
+
+  if(MBC == MBC_ROM_ONLY){
+    _read_handler  = &Cartridge::mapped_read<&Cartridge::rom_only_read>;
+    _write_handler = &Cartridge::mapped_write<&Cartridge::rom_only_write>;
+    rom_only_map_banks();
+  }
+  else if(MBC >= MBC_1_INIT and MBC <= MBC_1_END){
+    _read_handler  = &Cartridge::mapped_read<&Cartridge::MBC1_read>;
+    _write_handler = &Cartridge::mapped_write<&Cartridge::MBC1_write>;
+    MBC1_map_banks();
+  }
+  else if(MBC >= MBC_3_INIT and MBC <= MBC_3_END){
+    _read_handler  = &Cartridge::mapped_read<&Cartridge::MBC3_read>;
+    _write_handler = &Cartridge::mapped_write<&Cartridge::MBC3_write>;
+    MBC3_map_banks();
+  }
+  else if(MBC >= MBC_5_INIT and MBC <= MBC_5_END){
+    _read_handler  = &Cartridge::mapped_read<&Cartridge::MBC5_read>;
+    _write_handler = &Cartridge::mapped_write<&Cartridge::MBC5_write>;
+    MBC5_map_banks();
+  }
+  else throw std::runtime_error(
+    "The current MBC is not supported by the emulator"
+  );
+
+  _mbc_read_handler = _read_handler;
+}
+
+/** Cartridge::rom_only_map_banks
+    The two ROM banks are fixed and there is no RAM
+
+*/
+void Cartridge::rom_only_map_banks(){
+  _rom0_ptr = rom_bank(0);
+  _romx_ptr = rom_bank(1);
+  _sram_ptr = nullptr;
+}
+
 /** Cartridge::rom_only_read
     Read the corresponding value from the only available bank
 
@@ -7,8 +110,9 @@
     @return uint8_t read byte
 */
 uint8_t Cartridge::rom_only_read(uint16_t addr){
-  if(addr >= VRAM_INIT_ADDR) throw std::runtime_error("Address not available in ROM_ONLY cartridges");
-  return _rom_banks[addr / ROM_SIZE][addr % ROM_SIZE];
+  if(addr < ROM_B00_END_ADDR) return _rom0_ptr[addr];
+  if(addr < VRAM_INIT_ADDR)   return _romx_ptr[addr - ROM_BNN_INIT_ADDR];
+  throw std::runtime_error("Address not available in ROM_ONLY cartridges");
 }
 
 /** Cartridge::rom_only_write
@@ -17,6 +121,22 @@ uint8_t Cartridge::rom_only_read(uint16_t addr){
 */
 void Cartridge::rom_only_write(uint16_t, uint8_t){ return; }
 
+/** Cartridge::MBC1_map_banks
+    Bank 0 is replaced by $20, $40... if banking mode 1 is used, and
+    the RAM is only banked in mode 1
+
+*/
+void Cartridge::MBC1_map_banks(){
+
+  if(_banking_mode == 0) _rom0_ptr = rom_bank(0);
+  else                   _rom0_ptr = rom_bank(_current_ram << 5);
+  _romx_ptr = rom_bank((_current_ram << 5) + _current_rom);
+
+  if(!_ram_bank_size or !_is_ram_enabled) _sram_ptr = nullptr;
+  else if(_banking_mode == 0)             _sram_ptr = ram_bank(0);
+  else                                    _sram_ptr = ram_bank(_current_ram);
+}
+
 /** Cartridge::MBC1_read
     Perform different accesses depending on the provided address,
     with respect to the MBC1 cartridge specifications.
@@ -26,20 +146,18 @@ void Cartridge::rom_only_write(uint16_t, uint8_t){ return; }
 */
 uint8_t Cartridge::MBC1_read(uint16_t addr){
 
-  // First bank or $10, $20... if banking mode 1 is used
+  // First bank or $20, $40... if banking mode 1 is used
   if(addr < ROM_B00_END_ADDR){
-    if(_banking_mode == 0) return _rom_banks[0][addr];
-    else                   return _rom_banks[(_current_ram << 5) % _rom_bank_size][addr % ROM_SIZE];
+    return _rom0_ptr[addr];
   }
   // Other banks
   else if(addr >= ROM_BNN_INIT_ADDR and addr < ROM_BNN_END_ADDR){
-    return _rom_banks[((_current_ram << 5) + _current_rom) % _rom_bank_size][addr % ROM_SIZE];
+    return _romx_ptr[addr - ROM_BNN_INIT_ADDR];
   }
   // Ram reading if available
   else if(addr >= RAM_BNN_INIT_ADDR and addr < RAM_BNN_END_ADDR){
-    if(!_ram_bank_size or !_is_ram_enabled) return 0xff;
-    if(_banking_mode == 0) return _ram_banks[0           ][addr % RAM_SIZE];
-    else                   return _ram_banks[_current_ram][addr % RAM_SIZE];
+    if(_sram_ptr == nullptr) return 0xff;
+    return _sram_ptr[addr - RAM_BNN_INIT_ADDR];
   }
 
   throw std::runtime_error("Address not available in MBC1 cartridges");
@@ -67,25 +185,42 @@ void Cartridge::MBC1_write(uint16_t addr, uint8_t data){
       _is_ram_enabled = 0;
       save_data_ram();
     }
+    MBC1_map_banks();
   }
   // Choose the rom to use
   if(addr >= MBC_WRITE2_INIT_ADDR and addr < MBC_WRITE2_END_ADDR){
     _current_rom = ((data & 0x1f) == 0) ? 1 : (data & 0x1f);
+    MBC1_map_banks();
   }
   // Choose the ram to use
   if(addr >= MBC_WRITE3_INIT_ADDR and addr < MBC_WRITE2_END_ADDR){
     _current_ram = (data & 0x03);
+    MBC1_map_banks();
   }
   // Write ram
   if(addr >= MBC_WRITE4_INIT_ADDR){
-    if(!_ram_bank_size or !_is_ram_enabled) return;
-    if(_banking_mode == 0) _ram_banks[0                            ][addr % RAM_SIZE] = data;
-    else                   _ram_banks[_current_ram % _ram_bank_size][addr % RAM_SIZE] = data;
+    if(_sram_ptr == nullptr) return;
+    _sram_ptr[addr - RAM_BNN_INIT_ADDR] = data;
+    mark_ram_dirty(addr);
     if(++_ram_access_counter > RAM_ACCESS_COUNTER_MAX) save_data_ram();
   }
 
 }
 
+/** Cartridge::MBC3_map_banks
+    Bank 0 is fixed, while the RAM bank is only mapped when one of the
+    RAM banks (and not the RTC) is selected
+
+*/
+void Cartridge::MBC3_map_banks(){
+
+  _rom0_ptr = rom_bank(0);
+  _romx_ptr = rom_bank(_current_rom);
+
+  if(!_ram_bank_size or !_is_ram_enabled or _current_ram >= MBC3_RAM_END_ADDR) _sram_ptr = nullptr;
+  else                                                                          _sram_ptr = ram_bank(_current_ram);
+}
+
 /** Cartridge::MBC3_read
     Perform different accesses depending on the provided address,
     with respect to the MBC3 cartridge specifications.
@@ -98,24 +233,18 @@ uint8_t Cartridge::MBC3_read(uint16_t addr){
 
   // Bank 0 rom
   if(addr < ROM_B00_END_ADDR){
-    return _rom_banks[0][addr];
+    return _rom0_ptr[addr];
   }
   // Bank N rom
   else if(addr >= ROM_BNN_INIT_ADDR and addr < ROM_BNN_END_ADDR){
-    return _rom_banks[_current_rom % _rom_bank_size][addr % ROM_SIZE];
+    return _romx_ptr[addr - ROM_BNN_INIT_ADDR];
   }
   // Use ram or RTC
   else if(addr >= RAM_BNN_INIT_ADDR and addr < RAM_BNN_END_ADDR){
-    if(!_is_ram_enabled){
-      return 0xff;
+    if(_sram_ptr != nullptr){
+      return _sram_ptr[addr - RAM_BNN_INIT_ADDR];
     }
-    if(_is_ram_enabled and _current_ram < MBC3_RAM_END_ADDR and _ram_bank_size == 0){
-      return 0xff;
-    }
-    if(_current_ram < MBC3_RAM_END_ADDR){
-      return _ram_banks[_current_ram][addr % RAM_SIZE];
-    }
-    else if(_current_ram >= MBC3_RTC_INIT_ADDR and _current_ram < MBC3_RTC_END_ADDR){
+    if(_is_ram_enabled and _current_ram >= MBC3_RTC_INIT_ADDR and _current_ram < MBC3_RTC_END_ADDR){
       return _RTC[_current_ram - MBC3_RTC_INIT_ADDR];
     }
     return 0xff;
@@ -143,14 +272,17 @@ void Cartridge::MBC3_write(uint16_t addr, uint8_t data){
       _is_ram_enabled = 0;
       save_data_ram();
     }
+    MBC3_map_banks();
   }
   // Pick current rom
   if(addr >= MBC_WRITE2_INIT_ADDR and addr < MBC_WRITE2_END_ADDR){
     _current_rom = ((data & 0x7f) == 0) ? 1 : (data & 0x7f);
+    MBC3_map_banks();
   }
   // Pick current ram
   if(addr >= MBC_WRITE3_INIT_ADDR and addr < MBC_WRITE3_END_ADDR){
     _current_ram = data;
+    MBC3_map_banks();
   }
   // Latch RTC if sequence of 0 -> 1 is written
   if(addr >= MBC_WRITE5_INIT_ADDR and addr < MBC_WRITE5_END_ADDR){
@@ -160,8 +292,11 @@ void Cartridge::MBC3_write(uint16_t addr, uint8_t data){
   // Write ram
   if(addr >= MBC_WRITE4_INIT_ADDR){
     if(!_is_ram_enabled) return;
-    if(_is_ram_enabled and _current_ram < MBC3_RAM_END_ADDR and _ram_bank_size == 0) return;
-    if(_current_ram < MBC3_RAM_END_ADDR)_ram_banks[_current_ram % _ram_bank_size][addr % RAM_SIZE] = data;
+    if(_current_ram < MBC3_RAM_END_ADDR and _ram_bank_size == 0) return;
+    if(_sram_ptr != nullptr){
+      _sram_ptr[addr - RAM_BNN_INIT_ADDR] = data;
+      mark_ram_dirty(addr);
+    }
     if(_current_ram >= MBC3_RTC_INIT_ADDR and _current_ram < MBC3_RTC_END_ADDR){
       _RTC[_current_ram - MBC3_RTC_INIT_ADDR] = data;
     }
@@ -177,6 +312,19 @@ void Cartridge::MBC3_write(uint16_t addr, uint8_t data){
 */
 void Cartridge::set_RTC(){}
 
+/** Cartridge::MBC5_map_banks
+    Bank 0 is fixed, while bank N uses 9 bits split in two registers
+
+*/
+void Cartridge::MBC5_map_banks(){
+
+  _rom0_ptr = rom_bank(0);
+  _romx_ptr = rom_bank(_current_rom | (_current_rom_up << 8));
+
+  if(!_ram_bank_size or !_is_ram_enabled) _sram_ptr = nullptr;
+  else                                    _sram_ptr = ram_bank(_current_ram);
+}
+
 /** Cartridge::MBC5_read
     Perform different accesses depending on the provided address,
     with respect to the MBC5 cartridge specifications.
@@ -187,28 +335,18 @@ void Cartridge::set_RTC(){}
 */
 uint8_t Cartridge::MBC5_read(uint16_t addr){
 
-  uint16_t rom_to_use = _current_rom | (_current_rom_up << 8);
-
   // Bank 0 rom
   if(addr < ROM_B00_END_ADDR){
-    return _rom_banks[0][addr];
+    return _rom0_ptr[addr];
   }
   // Bank N rom
   else if(addr >= ROM_BNN_INIT_ADDR and addr < ROM_BNN_END_ADDR){
-    return _rom_banks[rom_to_use % _rom_bank_size][addr % ROM_SIZE];
+    return _romx_ptr[addr - ROM_BNN_INIT_ADDR];
   }
   // Use RAM (no RTC available in MBC5)
   else if(addr >= RAM_BNN_INIT_ADDR and addr < RAM_BNN_END_ADDR){
-    if(!_is_ram_enabled){
-      return 0xff;
-    }
-    if(_ram_bank_size == 0){
-      return 0xff;
-    }
-    if(_current_ram < _ram_bank_size){
-      return _ram_banks[_current_ram][addr % RAM_SIZE];
-    }
-    return 0xff;
+    if(_sram_ptr == nullptr) return 0xff;
+    return _sram_ptr[addr - RAM_BNN_INIT_ADDR];
   }
 
   throw std::runtime_error("Address not available in MBC5 cartridges");
@@ -232,21 +370,24 @@ void Cartridge::MBC5_write(uint16_t addr, uint8_t data){
     else if(data == 0x0a){
       _is_ram_enabled = 1;
     }
+    MBC5_map_banks();
   }
   if(addr >= MBC5_WRITE2_INIT_ADDR and addr < MBC5_WRITE2_END_ADDR){
     _current_rom = data;
+    MBC5_map_banks();
   }
   if(addr >= MBC5_WRITE3_INIT_ADDR and addr < MBC5_WRITE3_END_ADDR){
     _current_rom_up = data & 0x01;
+    MBC5_map_banks();
   }
   if(addr >= MBC5_WRITE4_INIT_ADDR and addr < MBC5_WRITE4_END_ADDR){
     _current_ram = data;
+    MBC5_map_banks();
   }
   if(addr >= MBC_WRITE4_INIT_ADDR){
-    if(!_is_ram_enabled) return;
-    if(_is_ram_enabled and _ram_bank_size == 0) return;
-    _ram_banks[_current_ram % _ram_bank_size][addr % RAM_SIZE] = data;
+    if(_sram_ptr == nullptr) return;
+    _sram_ptr[addr - RAM_BNN_INIT_ADDR] = data;
+    mark_ram_dirty(addr);
     if(++_ram_access_counter > RAM_ACCESS_COUNTER_MAX) save_data_ram();
   }
 }
-
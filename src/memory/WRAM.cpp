@@ -1,4 +1,5 @@
 #include "WRAM.h"
+#include "../utils/hash.h"
 
 /** WRAM::read
     Read by from wram at a given address, using
@@ -10,18 +11,15 @@
 */
 uint8_t WRAM::read(uint16_t addr){
   uint8_t res = 0;
-  uint8_t bank_to_use = 0;
 
   if(addr >= size_addr)
     throw std::invalid_argument( "Address of provided to WRAM over the limit\n" );
 
   if(addr < MMU_BANK_WRAM_SIZE){
-    res = memory[bank_to_use][addr];
+    res = memory[0][addr];
   }
   else{
-    bank_to_use = _bus_to_read->read(MMU_SVBK_REG_INIT_ADDR) & 0b00000111;
-    if(bank_to_use == 0) bank_to_use = 1;
-    res = memory[bank_to_use][addr - MMU_BANK_WRAM_SIZE];
+    res = _bank_ptr[addr - MMU_BANK_WRAM_SIZE];
   }
 
   return res;
@@ -36,21 +34,56 @@ uint8_t WRAM::read(uint16_t addr){
 
 */
 void WRAM::write(uint16_t addr, uint8_t data){
-  uint8_t bank_to_use = 0;
 
   if(addr >= size_addr)
     throw std::invalid_argument( "Address of provided to WRAM over the limit\n" );
 
   if(addr < MMU_BANK_WRAM_SIZE){
-    memory[bank_to_use][addr] = data;
+    memory[0][addr] = data;
   }
   else{
-    bank_to_use = _bus_to_read->read(MMU_SVBK_REG_INIT_ADDR) & 0b00000111;
-    if(bank_to_use == 0) bank_to_use = 1;
-    memory[bank_to_use][addr - MMU_BANK_WRAM_SIZE] = data;
+    _bank_ptr[addr - MMU_BANK_WRAM_SIZE] = data;
   }
 }
 
+/** WRAM::get_memory_pointer
+    Return a pointer to the content of the wram, using the current
+    bank for addresses 0xD000-0xDFFF. The range cannot span over
+    both the banks
+
+    @param addr uint16_t first address of the range
+    @param size uint16_t number of bytes of the range
+    @return const uint8_t* pointer to the first byte, nullptr if not available
+
+*/
+const uint8_t* WRAM::get_memory_pointer(uint16_t addr, uint16_t size){
+
+  if(addr < MMU_BANK_WRAM_SIZE){
+    if(addr + size > MMU_BANK_WRAM_SIZE) return nullptr;
+    return memory[0].data() + addr;
+  }
+
+  if(addr + size > size_addr) return nullptr;
+  return _bank_ptr + (addr - MMU_BANK_WRAM_SIZE);
+}
+
+/** WRAM::register_written
+    Map the bank selected by the SVBK register at 0xD000-0xDFFF
+
+    @param addr uint16_t address of the written register
+    @param data uint8_t  new value of the register
+
+*/
+void WRAM::register_written(uint16_t addr, uint8_t data){
+  uint8_t bank_to_use;
+
+  if(addr != MMU_SVBK_REG_INIT_ADDR) return;
+
+  bank_to_use = data & 0b00000111;
+  if(bank_to_use == 0) bank_to_use = 1;
+  _bank_ptr = memory[bank_to_use].data();
+}
+
 /** WRAM::WRAM
     WRAM constructor. Sets working frequency to 0.
 
@@ -64,4 +97,19 @@ WRAM::WRAM(std::string name, uint16_t init_addr, uint16_t size) : Bus_obj(name,
 
   memory.resize(MMU_BANK_WRAM_NUMBER);
   for(auto& bank : memory) bank.resize(MMU_BANK_WRAM_SIZE);
+
+  // Bank 1 until SVBK is connected
+  _bank_ptr = memory[1].data();
+}
+
+/** WRAM::get_state_hash
+    Hash of the content of all the WRAM banks
+
+    @param seed uint64_t hash to chain with
+    @return uint64_t resulting hash
+
+*/
+uint64_t WRAM::get_state_hash(uint64_t seed){
+  for(auto& bank : memory) seed = gb_hash64(bank.data(), bank.size(), seed);
+  return seed;
 }
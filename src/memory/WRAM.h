@@ -8,23 +8,23 @@
 #include <cstring>
 #include <fstream>
 #include "../bus/bus_obj.h"
+#include "register.h"
 
-class WRAM : public Bus_obj  {
+class WRAM : public Bus_obj, public Register_listener  {
   std::vector<std::vector<uint8_t>> memory;
 
-public:
+  // Bank mapped at 0xD000-0xDFFF, updated on writes of the SVBK register
+  uint8_t* _bank_ptr;
 
-  /*
-   * WRAM requires to read the bus while performing
-   * a reading/writing operation, in order to get the
-   * current value of SVBK register.
-   * */
-  Bus_obj* _bus_to_read;
+public:
 
             WRAM(std::string, uint16_t, uint16_t);
   uint8_t   read(uint16_t);
   void      write(uint16_t, uint8_t);
   void      step(Bus_obj*){}
+  const uint8_t* get_memory_pointer(uint16_t, uint16_t);
+  void      register_written(uint16_t, uint8_t);
+  uint64_t  get_state_hash(uint64_t);
             ~WRAM(){}
 };
 
@@ -1,74 +1,46 @@
 #include "cartridge.h"
+#include "../utils/hash.h"
 #include <iostream>
 #include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 extern gb_global_t gb_global;
 
 /** Cartridge::read
-    Read a data from a cartridge, referring to different
-    methods depending on the type of used cartridge.
+    Read a data from a cartridge, using the handler selected
+    for the type of cartridge when the ROM was loaded.
 
     @param addr uint16_t address to read
     @return uint8_t read byte
 */
 uint8_t Cartridge::read(uint16_t addr){
-  uint8_t vram_bank_to_use;
-
-  // Use the content of BROM_EN to know whether the BOOT ROM
-  // should be used or not.
-  if(gb_global.gbc_mode == 0 and addr < MMU_BOOT_DMG_SIZE and _using_boot_rom){
-    if(_bus_to_read->read(MMU_BROM_EN_INIT_ADDR) != 0) _using_boot_rom = 0;
-    else return _BOOT_ROM[addr];
-  }
-
-  // Handle boot rom mapping in cgb mode
-  if(gb_global.gbc_mode == 1 and addr < MMU_BOOT_CGB_SIZE and _using_boot_rom){
-    if(_bus_to_read->read(MMU_BROM_EN_INIT_ADDR) != 0) _using_boot_rom = 0;
-    else{
-      if(addr < 0x100 or addr >= 0x200) return _BOOT_ROM[addr];
-    }
-  }
-
-  if(addr >= VRAM_INIT_ADDR and addr < VRAM_END_ADDR){
-    vram_bank_to_use = _bus_to_read->read(MMU_VBK_REG_INIT_ADDR) & 1;
-    if(!vram_bank_to_use) return _VRAM_0[addr - VRAM_INIT_ADDR];
-    else                  return _VRAM_1[addr - VRAM_INIT_ADDR];
-  }
-
-  if     (MBC == MBC_ROM_ONLY)                    return rom_only_read(addr);
-  else if(MBC >= MBC_1_INIT and MBC <= MBC_1_END) return MBC1_read(addr);
-  else if(MBC >= MBC_3_INIT and MBC <= MBC_3_END) return MBC3_read(addr);
-  else if(MBC >= MBC_5_INIT and MBC <= MBC_5_END) return MBC5_read(addr);
-
-  else throw std::runtime_error(
-    "The current MBC is not supported by the emulator"
-  );
+  return (this->*_read_handler)(addr);
 }
 
 /** Cartridge::write
-    Write a data to a cartridge, referring to different
-    methods depending on the type of used cartridge.
+    Write a data to a cartridge, using the handler selected
+    for the type of cartridge when the ROM was loaded.
 
     @param addr uint16_t address to use
     @param data uint8_t  byte to write
 */
 void Cartridge::write(uint16_t addr, uint8_t data){
-  uint8_t vram_bank_to_use;
+  (this->*_write_handler)(addr, data);
+}
 
-  if(addr >= VRAM_INIT_ADDR and addr < VRAM_END_ADDR){
-    vram_bank_to_use = _bus_to_read->read(MMU_VBK_REG_INIT_ADDR) & 1;
-    if(!vram_bank_to_use) _VRAM_0[addr - VRAM_INIT_ADDR] = data;
-    else                  _VRAM_1[addr - VRAM_INIT_ADDR] = data;
-    return;
-  }
+/** Cartridge::boot_rom_read
+    Read handler used while the boot rom is mapped over the first bytes of
+    the ROM. In CGB mode, the header at 0x100-0x1FF is still visible.
 
-  if     (MBC == MBC_ROM_ONLY)                    rom_only_write(addr, data);
-  else if(MBC >= MBC_1_INIT and MBC <= MBC_1_END) MBC1_write(addr, data);
-  else if(MBC >= MBC_3_INIT and MBC <= MBC_3_END) MBC3_write(addr, data);
-  else if(MBC >= MBC_5_INIT and MBC <= MBC_5_END) MBC5_write(addr, data);
-  else throw std::runtime_error(
-    "The current MBC is not supported by the emulator"
-  );
+    @param addr uint16_t address to read
+    @return uint8_t read byte
+*/
+uint8_t Cartridge::boot_rom_read(uint16_t addr){
+  if(addr < _BOOT_ROM.size() and (addr < 0x100 or addr >= 0x200)) return _BOOT_ROM[addr];
+  return (this->*_mbc_read_handler)(addr);
 }
 
 /** Cartridge::Cartridge
@@ -82,102 +54,223 @@ void Cartridge::write(uint16_t addr, uint8_t data){
 Cartridge::Cartridge(std::string name, uint16_t init_addr, uint16_t size) : Bus_obj(name, init_addr, size){
   _VRAM_0.resize(RAM_SIZE);
   _VRAM_1.resize(RAM_SIZE);
+  _vram_ptr = _VRAM_0.data();
   _is_ram_enabled = 0;
   _banking_mode = 0;
   _current_rom = 1;
+  _current_rom_up = 0;
+  _current_ram = 0;
+  _ram_access_counter = 0;
+  _save_writer = nullptr;
+  _ram_dirty = false;
+  _ram_data = nullptr;
+  _ram_size = 0;
+  _save_mapped = false;
+  _ram_mapped = false;
   _RTC_to_latch = 0;
   _using_boot_rom = 0;
+  _save_enabled = true;
+  _rom = nullptr;
+  _rom_size = 0;
+  _rom_data = nullptr;
+  _rom0_ptr = nullptr;
+  _romx_ptr = nullptr;
+  _sram_ptr = nullptr;
+  _read_handler = nullptr;
+  _write_handler = nullptr;
+  _mbc_read_handler = nullptr;
+}
+
+/** Cartridge::~Cartridge
+    Cartridge destructor, saving the last changes of the RAM and releasing
+    the mapping of the ROM file
+
+*/
+Cartridge::~Cartridge(){
+  if(_save_writer != nullptr){
+    save_data_ram();
+    delete _save_writer;
+  }
+  if(_ram_mapped){
+    msync(_ram_data, _ram_size, MS_SYNC);
+    munmap(_ram_data, _ram_size);
+  }
+  if(_rom != nullptr) munmap((void*) _rom, _rom_size);
+}
+
+/** Cartridge::register_written
+    Select the VRAM bank accessed by the CPU when the VBK register is written,
+    and unmap the boot rom once BROM_EN is written with a non-zero value
+
+    @param addr uint16_t address of the written register
+    @param data uint8_t  new value of the register
+
+*/
+void Cartridge::register_written(uint16_t addr, uint8_t data){
+  if(addr == MMU_VBK_REG_INIT_ADDR){
+    if(!(data & 1)) _vram_ptr = _VRAM_0.data();
+    else            _vram_ptr = _VRAM_1.data();
+  }
+  else if(addr == MMU_BROM_EN_INIT_ADDR and data != 0 and _using_boot_rom){
+    _using_boot_rom = 0;
+    _read_handler = _mbc_read_handler;
+  }
 }
 
 /** Cartridge::init_from_file
-    Initialize the content of the cartridge using a file.
+    Initialize the content of the cartridge using a file. The file is mapped
+    in memory rather than read, so that loading does not depend on its size
+    and the same ROM is shared by all the processes using it.
 
-    @param init_addr uint16_t Initial address in which the file is moved
     @param file_name std::string Name of the file to use
 
 */
 void Cartridge::init_from_file(std::string file_name){
 
-  // Variables to handle reading
-  std::ifstream file;
-  std::ifstream stream(file_name);
-  char byte;
-
-  // Internal variables
-  uint64_t current_address = 0;
-  uint32_t current_rom_bank = 0;
+  struct stat file_info;
+  void*       mapping;
+  uint8_t     cgb_flag;
+  uint8_t     ram_size;
+  uint32_t    file_rom_banks;
 
   // Save file name
   _save_file_name = file_name + ".save";
 
-  if(stream.is_open()){
+  int file = open(file_name.c_str(), O_RDONLY);
+  if(file < 0){
+    throw std::invalid_argument(
+      "File for " + this->name + " not opened correctly.\nThe path might be wrong!"
+    );
+  }
+
+  if(fstat(file, &file_info) != 0 or file_info.st_size < ROM_MIN_FILE_SIZE){
+    close(file);
+    throw std::runtime_error("File for " + this->name + " is too small to contain a ROM");
+  }
+
+  // The mapping stays valid once the file is closed
+  mapping = mmap(nullptr, file_info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+  close(file);
+
+  if(mapping == MAP_FAILED){
+    throw std::runtime_error("File for " + this->name + " cannot be mapped in memory");
+  }
+
+  _rom = (const uint8_t*) mapping;
+  _rom_size = file_info.st_size;
 
-    while(stream.get(byte)){
-      current_rom_bank = current_address / ROM_SIZE;
-
-      // Add a new bank of rom if necessary
-      if(_rom_banks.size() == current_rom_bank){
-        _rom_banks.push_back(std::vector<uint8_t>(ROM_SIZE));
-      }
-
-      // Read from file and store in the current address of the current bank
-      _rom_banks[current_rom_bank][current_address % ROM_SIZE] = byte;
-
-      // Write the MBC value if address is reached
-      if(current_address == MBC_HEADER_ADDR){
-        MBC = byte;
-      }
-
-      // Write the rom bank size value if address is reached
-      if(current_address == ROM_SIZE_HEADER_ADDR){
-        _rom_bank_size = (1 << (byte + 1));
-      }
-
-      if(current_address == MBC_HEADER_CGB){
-        if((uint8_t)byte == 0x80 or (uint8_t)byte == 0xC0){
-          #ifdef __DEBUG
-          printf("[CGB mode on]\n");
-          #endif
-          gb_global.gbc_mode = 1;
-        }
-        else{
-          #ifdef __DEBUG
-          printf("[CGB mode off]\n");
-          #endif
-          gb_global.gbc_mode = 0;
-        }
-      }
-
-      // Write the ram bank size value if address is reached
-      if(current_address == RAM_SIZE_HEADER_ADDR){
-        _ram_bank_size = (byte == 0) ? 0  :
-                         (byte == 2) ? 1  :
-                         (byte == 3) ? 4  :
-                         (byte == 4) ? 16 :
-                                       8  ;
-      }
-
-      current_address++;
-    }
+  // Read the cartridge type and the sizes from the header
+  MBC = _rom[MBC_HEADER_ADDR];
+  _rom_bank_size = (1 << (_rom[ROM_SIZE_HEADER_ADDR] + 1));
 
+  cgb_flag = _rom[MBC_HEADER_CGB];
+  if(cgb_flag == 0x80 or cgb_flag == 0xC0){
+    #ifdef __DEBUG
+    printf("[CGB mode on]\n");
+    #endif
+    gb_global.gbc_mode = 1;
   }
   else{
-    throw std::invalid_argument(
-      "File for " + this->name + " not opened correctly.\nThe path might be wrong!"
-    );
+    #ifdef __DEBUG
+    printf("[CGB mode off]\n");
+    #endif
+    gb_global.gbc_mode = 0;
   }
 
-  // Double check of the used rom banks with respect to what was read from the header
-  if(current_rom_bank + 1 != _rom_bank_size){
+  ram_size = _rom[RAM_SIZE_HEADER_ADDR];
+  _ram_bank_size = (ram_size == 0) ? 0  :
+                   (ram_size == 2) ? 1  :
+                   (ram_size == 3) ? 4  :
+                   (ram_size == 4) ? 16 :
+                                     8  ;
+
+  // Double check of the banks in the file with respect to what was read from the header
+  file_rom_banks = (_rom_size + ROM_SIZE - 1) / ROM_SIZE;
+  if(file_rom_banks != _rom_bank_size){
     throw std::runtime_error("Mismatch between rom banks used and read\n");
   }
 
-  // Create ram banks
-  for(int i = 0; i < _ram_bank_size; i++)
-    _ram_banks.push_back(std::vector<uint8_t>(RAM_SIZE));
+  // The part of the last bank missing from the file cannot be accessed through the
+  // mapping, so a truncated ROM is completed with zeros in a copy
+  _rom_data = _rom;
+  if(_rom_size % ROM_SIZE != 0){
+    _rom_padded.assign(_rom, _rom + _rom_size);
+    _rom_padded.resize(_rom_bank_size * ROM_SIZE, 0);
+    _rom_data = _rom_padded.data();
+  }
 
+  init_ram();
+  select_handlers();
   set_boot_rom();
-  reset_save_data_ram();
+
+  // A mapped save file already is the content of the RAM
+  if(!_ram_mapped){
+    reset_save_data_ram();
+    if(_save_enabled and _ram_bank_size != 0)
+      _save_writer = new Save_writer(_save_file_name, _ram_data, _ram_size);
+  }
+}
+
+/** Cartridge::init_ram
+    Create the ram banks, stored contiguously, either in memory or in the
+    mapped save file
+
+*/
+void Cartridge::init_ram(){
+
+  _ram_size = _ram_bank_size * RAM_SIZE;
+  _ram_dirty_pages.assign((_ram_size + SAVE_WRITER_PAGE_SIZE - 1) / SAVE_WRITER_PAGE_SIZE, 0);
+
+  if(_save_mapped and _save_enabled and _ram_size != 0 and map_save_file()) return;
+
+  _ram.resize(_ram_size);
+  _ram_data = _ram.data();
+}
+
+/** Cartridge::map_save_file
+    Map the save file in memory as the cartridge RAM. A new save file is
+    created with the size of the RAM, while a file of a different size is
+    left untouched, and the RAM is kept in memory
+
+    @return bool true if the save file is used as RAM
+
+*/
+bool Cartridge::map_save_file(){
+
+  struct stat file_info;
+  void*       mapping;
+
+  int file = open(_save_file_name.c_str(), O_RDWR | O_CREAT, 0644);
+  if(file < 0){
+    std::cerr << "Save file " << _save_file_name << " cannot be opened, it is not mapped." << std::endl;
+    return false;
+  }
+
+  if(fstat(file, &file_info) != 0 or
+     (file_info.st_size == 0 and ftruncate(file, _ram_size) != 0)){
+    std::cerr << "Save file " << _save_file_name << " cannot be created, it is not mapped." << std::endl;
+    close(file);
+    return false;
+  }
+
+  // The mismatch is reported when the save is restored
+  if(file_info.st_size != 0 and (size_t) file_info.st_size != _ram_size){
+    close(file);
+    return false;
+  }
+
+  // The mapping stays valid once the file is closed
+  mapping = mmap(nullptr, _ram_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  close(file);
+
+  if(mapping == MAP_FAILED){
+    std::cerr << "Save file " << _save_file_name << " cannot be mapped in memory." << std::endl;
+    return false;
+  }
+
+  _ram_data = (uint8_t*) mapping;
+  _ram_mapped = true;
+  return true;
 }
 
 /** Cartridge::set_boot_rom
@@ -363,32 +456,38 @@ void Cartridge::set_boot_rom(){
     for(uint32_t i = 0; i < cgb_boot_rom.size(); i++) _BOOT_ROM[i] = cgb_boot_rom[i];
   }
 
+  // The boot rom is read first, until BROM_EN is written
   _using_boot_rom = 1;
+  _read_handler = &Cartridge::boot_rom_read;
 }
 
 /** Cartridge::save_data_ram
-    The content of the RAM is saved on the external file
+    The content of the RAM is saved on the external file, if it was written
+    since the last save. The file is written by the save writer thread, so
+    this only costs the comparison of the written pages
 
 */
 void Cartridge::save_data_ram(){
 
-  std::ofstream stream(_save_file_name);
-
   // Reset access counter
   _ram_access_counter = 0;
 
-  #ifdef __DEBUG
-  // printf("Content of RAM is being saved...\n");
-  #endif
+  if(_save_writer == nullptr or !_ram_dirty) return;
 
-  if(stream.is_open()){
-    for(auto& bank : _ram_banks){
-      for(auto& byte : bank) stream << byte;
-    }
-  }
-  else{
-    throw std::invalid_argument("Save file " + this->name + " not opened correctly.");
-  }
+  _save_writer->update(_ram_data, _ram_dirty_pages);
+  _ram_dirty = false;
+}
+
+/** Cartridge::flush_save_data_ram
+    Called at the end of each frame. When the save file is mapped, the OS
+    is asked to write the RAM written during the frame, without waiting
+
+*/
+void Cartridge::flush_save_data_ram(){
+  if(!_ram_mapped or !_ram_dirty) return;
+
+  msync(_ram_data, _ram_size, MS_ASYNC);
+  _ram_dirty = false;
 }
 
 /** Cartridge::reset_save_data_ram
@@ -400,15 +499,10 @@ void Cartridge::reset_save_data_ram(){
 
   // Variables to handle reading
   std::ifstream stream(_save_file_name);
-  char byte;
-
-  // Internal variables
-  uint64_t current_address = 0;
-  uint32_t current_ram_bank = 0;
 
   // If it's the first time a game is run, or if the game does not have RAM, the
   // save file does not exist. In this case, we just return
-  if(!std::filesystem::exists(_save_file_name)) return;
+  if(!_save_enabled or !std::filesystem::exists(_save_file_name)) return;
 
   // If the file is not of the expected size, then it might be correupted. In this case, we
   // do not use it.
@@ -420,12 +514,8 @@ void Cartridge::reset_save_data_ram(){
   // Check if the file is properly opened
   if(stream.is_open()){
 
-    // Read and store one byte at a time
-    while(stream.get(byte)){
-      current_ram_bank = current_address / RAM_SIZE;
-      _ram_banks[current_ram_bank][current_address % RAM_SIZE] = byte;
-      current_address++;
-    }
+    // The size of the file matches the one of the RAM
+    stream.read((char*) _ram_data, _ram_size);
 
   }
   else{
@@ -459,3 +549,106 @@ uint8_t Cartridge::read_vram(uint8_t bank, uint16_t addr){
 
   return res;
 }
+
+/** Cartridge::get_memory_pointer
+    Return a pointer to the bank currently mapped at a range of addresses.
+    The RAM is only available when it is enabled and not replaced by the RTC,
+    and the beginning of the ROM is not available while the boot rom is mapped
+
+    @param addr uint16_t first address of the range
+    @param size uint16_t number of bytes of the range
+    @return const uint8_t* pointer to the first byte, nullptr if not available
+
+*/
+const uint8_t* Cartridge::get_memory_pointer(uint16_t addr, uint16_t size){
+
+  uint32_t end = addr + size;
+
+  if(addr < ROM_B00_END_ADDR){
+    if(_using_boot_rom or end > ROM_B00_END_ADDR) return nullptr;
+    return _rom0_ptr + addr;
+  }
+
+  if(addr < ROM_BNN_END_ADDR){
+    if(end > ROM_BNN_END_ADDR) return nullptr;
+    return _romx_ptr + (addr - ROM_BNN_INIT_ADDR);
+  }
+
+  if(addr < VRAM_END_ADDR){
+    if(end > VRAM_END_ADDR) return nullptr;
+    return _vram_ptr + (addr - VRAM_INIT_ADDR);
+  }
+
+  if(_sram_ptr == nullptr or end > RAM_BNN_END_ADDR) return nullptr;
+  return _sram_ptr + (addr - RAM_BNN_INIT_ADDR);
+}
+
+/** Cartridge::get_vram_pointer
+    Direct access to the VRAM bank selected by VBK, for the objects
+    which write it without going through the bus (the HDMA)
+
+    @return uint8_t* pointer to the first byte of the bank
+
+*/
+uint8_t* Cartridge::get_vram_pointer(){
+  return _vram_ptr;
+}
+
+/** Cartridge::get_save_writer
+    @return Save_writer* writer of the save file, nullptr if the save is
+                         disabled, mapped in memory or not present
+
+*/
+Save_writer* Cartridge::get_save_writer(){
+  return _save_writer;
+}
+
+/** Cartridge::is_boot_rom_mapped
+    @return bool true until the boot rom is unmapped by writing BROM_EN
+
+*/
+bool Cartridge::is_boot_rom_mapped(){
+  return _using_boot_rom != 0;
+}
+
+/** Cartridge::get_state_hash
+    Hash of the content of the cartridge RAM and of the VRAM, together
+    with the current banking state
+
+    @param seed uint64_t hash to chain with
+    @return uint64_t resulting hash
+
+*/
+uint64_t Cartridge::get_state_hash(uint64_t seed){
+
+  uint8_t banking[] = {_current_rom, _current_rom_up, _current_ram, _is_ram_enabled, _banking_mode, _using_boot_rom};
+
+  for(uint32_t i = 0; i < _ram_bank_size; i++) seed = gb_hash64(_ram_data + i * RAM_SIZE, RAM_SIZE, seed);
+  seed = gb_hash64(_VRAM_0.data(), _VRAM_0.size(), seed);
+  seed = gb_hash64(_VRAM_1.data(), _VRAM_1.size(), seed);
+
+  return gb_hash64(banking, sizeof(banking), seed);
+}
+
+/** Cartridge::set_save_enabled
+    Decide whether the content of the cartridge RAM is restored from and
+    stored to the save file. Must be called before `init_from_file`.
+
+    @param enabled bool true to use the save file
+
+*/
+void Cartridge::set_save_enabled(bool enabled){
+  _save_enabled = enabled;
+}
+
+/** Cartridge::set_save_mapped
+    Decide whether the save file is mapped in memory and used directly as
+    the cartridge RAM, instead of being copied in and out of it. Must be
+    called before `init_from_file`.
+
+    @param mapped bool true to map the save file
+
+*/
+void Cartridge::set_save_mapped(bool mapped){
+  _save_mapped = mapped;
+}
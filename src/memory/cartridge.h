@@ -10,12 +10,23 @@
 #include "memory_map.h"
 #include "../utils/gb_global_t.h"
 #include "../memory/memory.h"
+#include "register.h"
+#include "../utils/save_writer.h"
 
 // How many writings to perform on cartidge ram
 // before saving the content to disc
 #define RAM_ACCESS_COUNTER_MAX 500000
 
-class Cartridge : public Bus_obj  {
+// Minimum size of a ROM file, which must contain the whole header
+#define ROM_MIN_FILE_SIZE 0x150
+
+class Cartridge;
+
+// Handlers of the accesses, depending on the type of cartridge
+typedef uint8_t (Cartridge::*Cartridge_read_handler)(uint16_t);
+typedef void    (Cartridge::*Cartridge_write_handler)(uint16_t, uint8_t);
+
+class Cartridge : public Bus_obj, public Register_listener  {
 
     uint8_t  MBC;
     uint16_t _rom_bank_size;
@@ -34,14 +45,59 @@ class Cartridge : public Bus_obj  {
 
     std::string _save_file_name;
     uint32_t _ram_access_counter;
+    bool     _save_enabled;
+
+    // The save file is written in background. The pages of RAM written since
+    // the last save are flagged, so that only those are compared and copied
+    Save_writer*         _save_writer;
+    std::vector<uint8_t> _ram_dirty_pages;
+    bool                 _ram_dirty;
+
+    // The ROM file is mapped read-only in memory, and the banks are read from the
+    // mapping. A ROM whose last bank is truncated is copied and padded instead
+    const uint8_t*       _rom;
+    size_t               _rom_size;
+    std::vector<uint8_t> _rom_padded;
+    const uint8_t*       _rom_data;
 
-    std::vector<std::vector<uint8_t>> _rom_banks;
-    std::vector<std::vector<uint8_t>> _ram_banks;
+    // The RAM is either stored in memory or, with `set_save_mapped`, it is the
+    // save file itself mapped in memory, whose changes are persisted by the OS
+    std::vector<uint8_t> _ram;
+    uint8_t*             _ram_data;
+    size_t               _ram_size;
+    bool                 _save_mapped;
+    bool                 _ram_mapped;
+
+    // Banks currently mapped at $0000, $4000 and $A000, only recomputed when the
+    // MBC registers are written. The RAM is not mapped when it is disabled
+    const uint8_t* _rom0_ptr;
+    const uint8_t* _romx_ptr;
+    uint8_t*       _sram_ptr;
 
     std::vector<uint8_t> _VRAM_0;
     std::vector<uint8_t> _VRAM_1;
+
+    // VRAM bank accessed by the CPU, updated on writes of the VBK register
+    uint8_t* _vram_ptr;
     std::vector<uint8_t> _BOOT_ROM;
 
+    // Handlers chosen once the type of cartridge is known. The MBC read handler
+    // is restored once the boot rom is unmapped
+    Cartridge_read_handler  _read_handler;
+    Cartridge_write_handler _write_handler;
+    Cartridge_read_handler  _mbc_read_handler;
+
+    template<Cartridge_read_handler mbc_read>    uint8_t mapped_read(uint16_t);
+    template<Cartridge_write_handler mbc_write>  void    mapped_write(uint16_t, uint8_t);
+    uint8_t boot_rom_read(uint16_t);
+    void    select_handlers();
+
+    const uint8_t* rom_bank(uint32_t);
+    uint8_t*       ram_bank(uint32_t);
+    void    rom_only_map_banks();
+    void    MBC1_map_banks();
+    void    MBC3_map_banks();
+    void    MBC5_map_banks();
     uint8_t rom_only_read(uint16_t);
     void    rom_only_write(uint16_t, uint8_t);
     uint8_t MBC1_read(uint16_t);
@@ -52,22 +108,30 @@ class Cartridge : public Bus_obj  {
     void    MBC5_write(uint16_t, uint8_t);
     void    set_RTC();
     void    set_boot_rom();
+    void    mark_ram_dirty(uint16_t);
+    void    init_ram();
+    bool    map_save_file();
     void    save_data_ram();
     void    reset_save_data_ram();
 
 public:
 
-  // Use a reference to the bus to perform the reading
-  // of the brom_en register.
-  Bus_obj* _bus_to_read;
-
             Cartridge(std::string, uint16_t, uint16_t);
   uint8_t   read(uint16_t);
   void      write(uint16_t, uint8_t);
   void      step(Bus_obj*){}
   void      init_from_file(std::string);
   uint8_t   read_vram(uint8_t, uint16_t);
-            ~Cartridge(){}
+  const uint8_t* get_memory_pointer(uint16_t, uint16_t);
+  uint8_t*  get_vram_pointer();
+  Save_writer* get_save_writer();
+  bool      is_boot_rom_mapped();
+  uint64_t  get_state_hash(uint64_t);
+  void      register_written(uint16_t, uint8_t);
+  void      set_save_enabled(bool);
+  void      set_save_mapped(bool);
+  void      flush_save_data_ram();
+            ~Cartridge();
 };
 
 #endif // !__CARTRIDGE_H
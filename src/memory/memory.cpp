@@ -1,4 +1,5 @@
 #include "memory.h"
+#include "../utils/hash.h"
 
 /** Memory::read
     Read by from memory at a given address
@@ -28,6 +29,30 @@ void Memory::write(uint16_t addr, uint8_t data){
   if(!ROM) this->memory[addr] = data;
 }
 
+/** Memory::get_memory_pointer
+    Return a pointer to the content of the memory
+
+    @param addr uint16_t first address of the range
+    @param size uint16_t number of bytes of the range
+    @return const uint8_t* pointer to the first byte, nullptr if out of the memory
+
+*/
+const uint8_t* Memory::get_memory_pointer(uint16_t addr, uint16_t size){
+  if(addr + size > size_addr) return nullptr;
+  return this->memory.data() + addr;
+}
+
+/** Memory::get_data
+    Direct access to the content of the memory, for the objects which
+    write it without going through the bus (the OAM DMA)
+
+    @return uint8_t* pointer to the first byte
+
+*/
+uint8_t* Memory::get_data(){
+  return this->memory.data();
+}
+
 /** Memory::Memory
     Memory constructor. Sets working frequency to 0.
 
@@ -75,3 +100,13 @@ void Memory::init_from_file(uint16_t init_addr, std::string file_name){
 
 }
 
+/** Memory::get_state_hash
+    Hash of the content of the memory
+
+    @param seed uint64_t hash to chain with
+    @return uint64_t resulting hash
+
+*/
+uint64_t Memory::get_state_hash(uint64_t seed){
+  return gb_hash64(this->memory.data(), this->memory.size(), seed);
+}
@@ -17,7 +17,10 @@ public:
   uint8_t   read(uint16_t);
   void      write(uint16_t, uint8_t);
   void      step(Bus_obj*){}
+  const uint8_t* get_memory_pointer(uint16_t, uint16_t);
+  uint8_t*  get_data();
   void      init_from_file(uint16_t, std::string);
+  uint64_t  get_state_hash(uint64_t);
             ~Memory(){}
 };
 
@@ -25,6 +25,20 @@ void Register::write(uint16_t addr, uint8_t data){
   if(addr != 0)
     throw std::invalid_argument( "Address of provided to " + name + " over the limit\n" );
   this->reg = data | (uint8_t)(~((1 << _available_bits) - 1));
+
+  for(auto listener : _listeners) listener->register_written(init_addr, this->reg);
+}
+
+/** Register::add_listener
+    Notify an object of the writes to the register. The object is notified
+    of the current value as well, so that it starts from a consistent state
+
+    @param listener Register_listener* object to notify
+
+*/
+void Register::add_listener(Register_listener* listener){
+  _listeners.push_back(listener);
+  listener->register_written(init_addr, this->reg);
 }
 
 /** Register::Register
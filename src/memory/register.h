@@ -7,16 +7,30 @@
 #include <cstring>
 #include "../bus/bus_obj.h"
 
+/*
+ * Interface of the objects notified when a register is written, such as the
+ * memories whose bank is selected by the register. They can cache what depends
+ * on the register instead of reading it through the bus at each access.
+ * */
+class Register_listener {
+public:
+  virtual void register_written(uint16_t, uint8_t) = 0;
+  virtual ~Register_listener() {};
+};
+
 class Register : public Bus_obj  {
 
   uint8_t reg;
   uint8_t _available_bits;
 
+  std::vector<Register_listener*> _listeners;
+
 public:
             Register(std::string, uint16_t, uint8_t,uint8_t = 0);
   uint8_t   read(uint16_t);
   void      write(uint16_t, uint8_t);
   void      step(Bus_obj*){}
+  void      add_listener(Register_listener*);
             ~Register(){}
 };
 
@@ -0,0 +1,595 @@
+#include "../gameboy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/*
+ * Benchmark suite: synthetic roms, assembled in memory, stress different parts
+ * of the emulator. Each rom runs headlessly for a fixed number of frames, and
+ * the emulated MHz, the frames per second and the time per instruction are
+ * reported, optionally also in a JSON file to track regressions.
+ *
+ *    ./gbbench [--frames N] [--json path] [benchmark ...]
+ *
+ * Without names, all the benchmarks are run.
+ * */
+
+#define BENCH_DEFAULT_FRAMES 600
+
+// Start of the Nintendo logo in the header, the part checked by the boot rom
+static const std::vector<uint8_t> BENCH_LOGO = {
+  0xce, 0xed, 0x66, 0x66, 0xcc, 0x0d, 0x00, 0x0b, 0x03, 0x73, 0x00, 0x83,
+  0x00, 0x0c, 0x00, 0x0d, 0x00, 0x08, 0x11, 0x1f, 0x88, 0x89, 0x00, 0x0e
+};
+
+/*
+ * Minimal assembler: bytes are emitted at the current address, and jumps
+ * to labels are fixed once the whole rom is written.
+ * */
+class Rom_builder {
+
+  std::vector<uint8_t>            _rom;
+  uint16_t                        _pc;
+  std::map<std::string, uint16_t> _labels;
+
+  // Relative ('r') or absolute ('a') jumps still to fix
+  struct Fixup { char type; uint16_t addr; std::string label; };
+  std::vector<Fixup>              _fixups;
+
+public:
+
+  Rom_builder(size_t size) : _rom(size, 0), _pc(0) {}
+
+  void org(uint16_t addr){ _pc = addr; }
+  void label(std::string name){ _labels[name] = _pc; }
+  void db(std::vector<uint8_t> bytes){ for(auto byte : bytes) _rom[_pc++] = byte; }
+  void dw(uint16_t word){ db({(uint8_t) word, (uint8_t) (word >> 8)}); }
+
+  void jr(uint8_t opcode, std::string label){ db({opcode}); _fixups.push_back({'r', _pc, label}); db({0}); }
+  void jp(uint8_t opcode, std::string label){ db({opcode}); _fixups.push_back({'a', _pc, label}); dw(0); }
+
+  // ld a,n ; ldh (n),a
+  void ldh(uint8_t reg, uint8_t value){ db({0x3e, value, 0xe0, reg}); }
+
+  void     fill(size_t, size_t, uint8_t (*)(size_t));
+  void     header(bool, uint8_t, uint8_t);
+  std::vector<uint8_t> build();
+};
+
+/** Rom_builder::fill
+    Fill part of the rom with a pattern
+
+    @param from size_t first byte to fill
+    @param to size_t last byte to fill, excluded
+    @param pattern uint8_t(*)(size_t) value of each byte given its address
+
+*/
+void Rom_builder::fill(size_t from, size_t to, uint8_t (*pattern)(size_t)){
+  for(size_t i = from; i < to; i++) _rom[i] = pattern(i);
+}
+
+/** Rom_builder::header
+    Write the header of the rom: entry point, logo, title, cartridge type
+    and header checksum
+
+    @param cgb bool whether the rom requires the CGB mode
+    @param type uint8_t cartridge type
+    @param rom_size uint8_t rom size code (32 KB << code)
+
+*/
+void Rom_builder::header(bool cgb, uint8_t type, uint8_t rom_size){
+
+  org(0x100);
+  db({0x00});
+  jp(0xc3, "start");
+  db(BENCH_LOGO);
+  org(0x134);
+  for(char c : std::string("GBBENCH")) db({(uint8_t) c});
+
+  _rom[0x143] = cgb ? 0x80 : 0x00;
+  _rom[0x147] = type;
+  _rom[0x148] = rom_size;
+  _rom[0x149] = 0;
+
+  uint8_t checksum = 0;
+  for(int i = 0x134; i < 0x14d; i++) checksum = checksum - _rom[i] - 1;
+  _rom[0x14d] = checksum;
+}
+
+/** Rom_builder::build
+    Fix the jumps and return the content of the rom
+
+    @return std::vector<uint8_t> content of the rom
+
+*/
+std::vector<uint8_t> Rom_builder::build(){
+
+  for(auto& fixup : _fixups){
+    if(_labels.count(fixup.label) == 0) throw std::invalid_argument("Unknown label " + fixup.label);
+    uint16_t target = _labels[fixup.label];
+
+    if(fixup.type == 'r'){
+      int offset = target - (fixup.addr + 1);
+      if(offset < -128 or offset > 127) throw std::invalid_argument("Jump to " + fixup.label + " out of range");
+      _rom[fixup.addr] = (uint8_t) offset;
+    }
+    else{
+      _rom[fixup.addr] = target & 0xff;
+      _rom[fixup.addr + 1] = target >> 8;
+    }
+  }
+
+  return _rom;
+}
+
+/** rom_pattern
+    Content of the rom banks, used as source of the copies
+
+    @param addr size_t address in the rom
+    @return uint8_t byte at that address
+
+*/
+static uint8_t rom_pattern(size_t addr){
+  return (addr * 7 + (addr >> 8)) & 0xff;
+}
+
+/** begin_program
+    Common beginning of the benchmarks: interrupt vectors, and code which turns
+    the LCD off, fills the tiles and the maps, and sets the palettes.
+    The program continues at the current address, with the LCD off
+
+    @param rom Rom_builder& rom to write
+
+*/
+static void begin_program(Rom_builder& rom){
+
+  rom.org(0x40);
+  rom.jp(0xc3, "vblank");
+  rom.org(0x48);
+  rom.jp(0xc3, "stat");
+
+  rom.org(0x150);
+  rom.label("start");
+  rom.db({0xf3, 0x31, 0xfe, 0xff});                         // di ; ld sp,$fffe
+
+  rom.label("wait_vblank");
+  rom.db({0xf0, 0x44, 0xfe, 144});                          // ldh a,(LY) ; cp 144
+  rom.jr(0x20, "wait_vblank");
+  rom.ldh(0x40, 0x00);                                      // LCD off
+
+  rom.db({0x21, 0x00, 0x80, 0x01, 0x00, 0x18});             // ld hl,$8000 ; ld bc,$1800
+  rom.label("fill_tiles");
+  rom.db({0x7d, 0xac, 0x22, 0x0b, 0x78, 0xb1});             // ld a,l ; xor h ; ld (hl+),a ; dec bc ; ld a,b ; or c
+  rom.jr(0x20, "fill_tiles");
+
+  rom.db({0x21, 0x00, 0x98, 0x01, 0x00, 0x08});             // ld hl,$9800 ; ld bc,$0800
+  rom.label("fill_maps");
+  rom.db({0x7d, 0x22, 0x0b, 0x78, 0xb1});                   // ld a,l ; ld (hl+),a ; dec bc ; ld a,b ; or c
+  rom.jr(0x20, "fill_maps");
+
+  rom.ldh(0x47, 0xe4);
+  rom.ldh(0x48, 0xd2);
+  rom.ldh(0x49, 0x1b);
+}
+
+/** start_program
+    Enable the interrupts and the LCD, then the main loop follows
+
+    @param rom Rom_builder& rom to write
+    @param interrupts uint8_t content of IE
+    @param lcdc uint8_t content of LCDC
+
+*/
+static void start_program(Rom_builder& rom, uint8_t interrupts, uint8_t lcdc){
+  rom.ldh(0x0f, 0x00);
+  rom.ldh(0xff, interrupts);
+  rom.ldh(0x40, lcdc);
+  rom.db({0xfb});                                           // ei
+}
+
+/** halt_loop
+    Main loop which waits for the interrupts
+
+    @param rom Rom_builder& rom to write
+
+*/
+static void halt_loop(Rom_builder& rom){
+  rom.label("main");
+  rom.db({0x76, 0x00});                                     // halt ; nop
+  rom.jr(0x18, "main");
+}
+
+/** empty_handlers
+    Handlers of the interrupts which are not used
+
+    @param rom Rom_builder& rom to write
+    @param vblank bool whether the vblank handler is needed too
+
+*/
+static void empty_handlers(Rom_builder& rom, bool vblank){
+  if(vblank){
+    rom.label("vblank");
+    rom.db({0xd9});
+  }
+  rom.label("stat");
+  rom.db({0xd9});
+}
+
+/** rom_alu
+    Arithmetic and logic instructions in a tight loop, without interrupts
+
+*/
+static std::vector<uint8_t> rom_alu(){
+  Rom_builder rom(0x8000);
+  begin_program(rom);
+  start_program(rom, 0x00, 0x91);
+
+  rom.label("main");
+  rom.db({0x80, 0x89, 0xaa, 0xa3, 0xb4, 0x04, 0x0d, 0xbd,   // add b ; adc c ; xor d ; and e ; or h ; inc b ; dec c ; cp l
+          0x93, 0x07, 0x27, 0x2f, 0x3c, 0x23, 0x19,         // sub e ; rlca ; daa ; cpl ; inc a ; inc hl ; add hl,de
+          0xcb, 0x11, 0xcb, 0x3f, 0xcb, 0x30, 0xcb, 0x47}); // rl c ; srl a ; swap b ; bit 0,a
+  rom.jr(0x18, "main");
+
+  empty_handlers(rom, true);
+  rom.header(false, 0x00, 0x00);
+  return rom.build();
+}
+
+/** rom_memcpy
+    Copies of 4 KB from the rom to the working ram, through loads and stores
+
+*/
+static std::vector<uint8_t> rom_memcpy(){
+  Rom_builder rom(0x8000);
+  rom.fill(0x4000, 0x8000, rom_pattern);
+  begin_program(rom);
+  start_program(rom, 0x00, 0x91);
+
+  rom.label("main");
+  rom.db({0x21, 0x00, 0x40, 0x11, 0x00, 0xc0, 0x01, 0x00, 0x10});  // ld hl,$4000 ; ld de,$c000 ; ld bc,$1000
+  rom.label("copy");
+  rom.db({0x2a, 0x12, 0x13, 0x0b, 0x78, 0xb1});             // ld a,(hl+) ; ld (de),a ; inc de ; dec bc ; ld a,b ; or c
+  rom.jr(0x20, "copy");
+  rom.jr(0x18, "main");
+
+  empty_handlers(rom, true);
+  rom.header(false, 0x00, 0x00);
+  return rom.build();
+}
+
+/** rom_sprites
+    40 objects of 8x16 pixels moving at each frame with the window on, an
+    OAM DMA at each vblank and a raster effect on the LYC interrupt
+
+*/
+static std::vector<uint8_t> rom_sprites(){
+  Rom_builder rom(0x8000);
+  begin_program(rom);
+
+  // Objects in $C100: y = 16 + 3i, x = 8 + 4i, tile = i, flags = i & $70
+  rom.db({0x21, 0x00, 0xc1, 0x06, 40, 0x0e, 0x00});         // ld hl,$c100 ; ld b,40 ; ld c,0
+  rom.label("objects");
+  rom.db({0x79, 0x87, 0x81, 0xc6, 16, 0x22,                 // ld a,c ; add a ; add c ; add 16 ; ld (hl+),a
+          0x79, 0x87, 0x87, 0xc6, 8, 0x22,                  // ld a,c ; add a ; add a ; add 8 ; ld (hl+),a
+          0x79, 0x22,                                       // ld a,c ; ld (hl+),a
+          0x79, 0xe6, 0x70, 0x22,                           // ld a,c ; and $70 ; ld (hl+),a
+          0x0c, 0x05});                                     // inc c ; dec b
+  rom.jr(0x20, "objects");
+
+  rom.ldh(0x4a, 80);                                        // WY
+  rom.ldh(0x4b, 87);                                        // WX
+  rom.ldh(0x45, 60);                                        // LYC
+  rom.ldh(0x41, 0x40);                                      // LYC interrupt
+  start_program(rom, 0x03, 0xf7);
+  halt_loop(rom);
+
+  rom.label("vblank");
+  rom.db({0xf5, 0xc5, 0xe5, 0xaf, 0xe0, 0x42});             // push af ; push bc ; push hl ; xor a ; ldh (SCY),a
+  rom.db({0xf0, 0x43, 0x3c, 0xe0, 0x43});                   // SCX++
+  rom.db({0x21, 0x01, 0xc0, 0x34});                         // frame counter in $C001
+  rom.ldh(0x46, 0xc1);                                      // OAM DMA from $C100
+  rom.db({0x3e, 40});
+  rom.label("dma_wait");
+  rom.db({0x3d});
+  rom.jr(0x20, "dma_wait");
+  rom.db({0x21, 0x01, 0xc1, 0x06, 40});                     // ld hl,$c101 ; ld b,40
+  rom.label("move");
+  rom.db({0x34, 0x23, 0x23, 0x23, 0x23, 0x05});             // x++ of each object
+  rom.jr(0x20, "move");
+  rom.db({0xe1, 0xc1, 0xf1, 0xd9});                         // pop hl ; pop bc ; pop af ; reti
+
+  rom.label("stat");
+  rom.db({0xf5, 0xfa, 0x01, 0xc0, 0xe0, 0x42, 0xf1, 0xd9}); // SCY = frame counter
+
+  rom.header(false, 0x00, 0x00);
+  return rom.build();
+}
+
+/** rom_hdma
+    CGB rom which, at each vblank, moves 1 KB with a general purpose DMA and
+    starts an HBLANK DMA of 2 KB, from a rom bank changing at each frame
+
+*/
+static std::vector<uint8_t> rom_hdma(){
+  Rom_builder rom(0x10000);
+  rom.fill(0x4000, 0x10000, rom_pattern);
+  begin_program(rom);
+  start_program(rom, 0x01, 0x91);
+  halt_loop(rom);
+
+  rom.label("vblank");
+  rom.db({0xf5, 0xfa, 0x01, 0xc0, 0x3c, 0xea, 0x01, 0xc0}); // push af ; frame counter in $C001
+  rom.db({0xe6, 0x03, 0xc6, 0x01, 0xea, 0x00, 0x20});       // rom bank = (counter & 3) + 1
+  rom.ldh(0x51, 0x40);
+  rom.ldh(0x52, 0x00);
+  rom.ldh(0x53, 0x00);
+  rom.ldh(0x54, 0x00);
+  rom.ldh(0x55, 0x3f);                                      // 64 chunks to $8000, general purpose
+  rom.ldh(0x51, 0x50);
+  rom.ldh(0x53, 0x08);
+  rom.ldh(0x55, 0xff);                                      // 128 chunks to $8800, HBLANK
+  rom.db({0xf1, 0xd9});
+  empty_handlers(rom, false);
+
+  rom.header(true, 0x19, 0x01);
+  return rom.build();
+}
+
+/** rom_apu
+    All the channels on, retriggered at each frame with a changing frequency
+
+*/
+static std::vector<uint8_t> rom_apu(){
+  Rom_builder rom(0x8000);
+  begin_program(rom);
+
+  std::vector<std::pair<uint8_t, uint8_t>> registers = {
+    {0x26, 0x80}, {0x24, 0x77}, {0x25, 0xff}, {0x10, 0x17}, {0x11, 0x80}, {0x12, 0xf3}, {0x13, 0x00},
+    {0x14, 0x87}, {0x16, 0x40}, {0x17, 0xa7}, {0x18, 0x80}, {0x19, 0x86}, {0x1a, 0x80}, {0x1c, 0x20},
+    {0x1d, 0x40}, {0x1e, 0x86}, {0x21, 0xf1}, {0x22, 0x31}, {0x23, 0x80}
+  };
+  for(int i = 0; i < 16; i++) rom.ldh(0x30 + i, (i * 0x11 + 0x37) & 0xff);
+  for(auto& reg : registers) rom.ldh(reg.first, reg.second);
+
+  start_program(rom, 0x01, 0x91);
+  halt_loop(rom);
+
+  rom.label("vblank");
+  rom.db({0xf5, 0xfa, 0x01, 0xc0, 0x3c, 0xea, 0x01, 0xc0}); // push af ; frame counter in $C001
+  rom.db({0xe0, 0x13, 0xe0, 0x18, 0xe0, 0x1d});             // low frequency of channels 1, 2, 3
+  rom.ldh(0x14, 0x87);
+  rom.ldh(0x19, 0x87);
+  rom.ldh(0x1e, 0x87);
+  rom.ldh(0x23, 0x80);
+  rom.db({0xf1, 0xd9});
+  empty_handlers(rom, false);
+
+  rom.header(false, 0x00, 0x00);
+  return rom.build();
+}
+
+/** rom_halt
+    The CPU is halted, and only wakes up to count the frames
+
+*/
+static std::vector<uint8_t> rom_halt(){
+  Rom_builder rom(0x8000);
+  begin_program(rom);
+  start_program(rom, 0x01, 0x91);
+  halt_loop(rom);
+
+  rom.label("vblank");
+  rom.db({0xf5, 0xfa, 0x01, 0xc0, 0x3c, 0xea, 0x01, 0xc0, 0xf1, 0xd9});
+  empty_handlers(rom, false);
+
+  rom.header(false, 0x00, 0x00);
+  return rom.build();
+}
+
+struct Bench_case {
+  std::string            name;
+  std::vector<uint8_t> (*rom)();
+  bool                   audio;
+};
+
+struct Bench_result {
+  std::string name;
+  uint32_t    frames;
+  double      seconds;
+  uint64_t    cycles;
+  uint64_t    instructions;
+};
+
+/** run_bench
+    Run one benchmark headlessly. The rom is written in a temporary file,
+    removed once the emulation completes. Only the frames after the boot
+    rom are measured
+
+    @param bench const Bench_case& benchmark to run
+    @param frames uint32_t number of frames to emulate after the boot rom
+    @return Bench_result measurements
+
+*/
+static Bench_result run_bench(const Bench_case& bench, uint32_t frames){
+
+  std::vector<uint8_t> content = bench.rom();
+
+  char rom_name[] = "/tmp/gbbench_XXXXXX";
+  int file = mkstemp(rom_name);
+  if(file < 0) throw std::runtime_error("Unable to create the rom of " + bench.name);
+  bool written = write(file, content.data(), content.size()) == (ssize_t) content.size();
+  close(file);
+  if(!written){
+    unlink(rom_name);
+    throw std::runtime_error("Unable to write the rom of " + bench.name);
+  }
+
+  gb_cli_args_t args;
+  args.rom_file_name = rom_name;
+  args.fixed_fps = false;
+  args.headless = true;
+  args.max_frames = frames;
+  args.capture_file_name = "";
+  // The waveforms are only synthesized when the audio is used
+  args.audio_file_name = bench.audio ? "/dev/null" : "";
+  args.audio_stems = false;
+  args.input_file_name = "";
+  args.hash_file_name = "";
+  args.hash_record = false;
+  args.no_save = true;
+  args.mmap_save = false;
+  args.sample_rate = GB_DEFAULT_SAMPLE_RATE;
+  args.audio_latency = GB_DEFAULT_AUDIO_LATENCY;
+  args.speed = 1;
+  args.profile_file_name = "";
+  args.perf_file_name = "";
+  args.stats_socket_name = "";
+
+  Bench_result result;
+  result.name = bench.name;
+
+  try{
+    Gameboy gb(args);
+
+    // The boot rom is the same for all the benchmarks: it is not measured
+    gb.run_boot();
+    uint32_t boot_frames = gb.get_frames();
+    uint64_t boot_cycles = gb.get_cycles();
+    uint64_t boot_instructions = gb.get_instructions();
+
+    auto start = std::chrono::steady_clock::now();
+    gb.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    result.frames = gb.get_frames() - boot_frames;
+    result.seconds = elapsed.count();
+    result.cycles = gb.get_cycles() - boot_cycles;
+    result.instructions = gb.get_instructions() - boot_instructions;
+  }
+  catch(...){
+    unlink(rom_name);
+    throw;
+  }
+
+  unlink(rom_name);
+  return result;
+}
+
+/** emulated_mhz
+    The emulated clock is the one of the CPU in single speed mode, at half
+    the frequency of the bus
+
+    @param result const Bench_result& measurements
+    @return double emulated frequency in MHz
+
+*/
+static double emulated_mhz(const Bench_result& result){
+  return result.cycles / 2.0 / result.seconds / 1e6;
+}
+
+/** ns_per_instruction
+    @param result const Bench_result& measurements
+    @return double mean wall time of an emulated instruction, in nanoseconds
+
+*/
+static double ns_per_instruction(const Bench_result& result){
+  return result.instructions ? result.seconds * 1e9 / result.instructions : 0;
+}
+
+/** write_json
+    Write the results in a JSON file
+
+    @param file_name std::string path of the file
+    @param results const std::vector<Bench_result>& results to write
+
+*/
+static void write_json(std::string file_name, const std::vector<Bench_result>& results){
+
+  std::ofstream file(file_name);
+  if(!file.is_open()) throw std::invalid_argument("Unable to create JSON file " + file_name);
+
+  file << "{\n  \"benchmarks\": [";
+  for(size_t i = 0; i < results.size(); i++){
+    const Bench_result& r = results[i];
+    file << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\""
+         << ", \"frames\": " << r.frames
+         << ", \"seconds\": " << r.seconds
+         << ", \"fps\": " << r.frames / r.seconds
+         << ", \"emulated_mhz\": " << emulated_mhz(r)
+         << ", \"instructions\": " << r.instructions
+         << ", \"ns_per_instruction\": " << ns_per_instruction(r) << "}";
+  }
+  file << "\n  ]\n}\n";
+}
+
+int main(int argc, char* argv[]){
+
+  const std::vector<Bench_case> benches = {
+    {"alu",     rom_alu,     false},
+    {"memcpy",  rom_memcpy,  false},
+    {"sprites", rom_sprites, false},
+    {"hdma",    rom_hdma,    false},
+    {"apu",     rom_apu,     true },
+    {"halt",    rom_halt,    false},
+  };
+
+  uint32_t frames = BENCH_DEFAULT_FRAMES;
+  std::string json_name = "";
+  std::vector<std::string> selected;
+
+  const std::string usage = "Usage: ./gbbench [--frames N] [--json path] [benchmark ...]";
+
+  for(int i = 1; i < argc; i++){
+    std::string current_argv = argv[i];
+    if(current_argv == "--frames" and i + 1 < argc)    frames = parse_unsigned(current_argv, argv[++i], usage, 1);
+    else if(current_argv == "--json" and i + 1 < argc) json_name = argv[++i];
+    else if(current_argv == "--help"){
+      std::cout << usage << std::endl;
+      std::cout << "Benchmarks:";
+      for(auto& bench : benches) std::cout << " " << bench.name;
+      std::cout << std::endl;
+      return 1;
+    }
+    else selected.push_back(current_argv);
+  }
+
+  for(auto& name : selected){
+    bool found = false;
+    for(auto& bench : benches) found |= bench.name == name;
+    if(!found){
+      std::cerr << "Unknown benchmark " << name << std::endl;
+      return 1;
+    }
+  }
+
+  std::vector<Bench_result> results;
+  printf("%-10s %8s %10s %10s %10s %14s\n", "benchmark", "frames", "seconds", "fps", "MHz", "ns/instruction");
+
+  try{
+    for(auto& bench : benches){
+      if(!selected.empty() and std::find(selected.begin(), selected.end(), bench.name) == selected.end()) continue;
+
+      Bench_result r = run_bench(bench, frames);
+      results.push_back(r);
+
+      printf("%-10s %8u %10.3f %10.1f %10.2f %14.2f\n", r.name.c_str(), r.frames, r.seconds, r.frames / r.seconds,
+             emulated_mhz(r), ns_per_instruction(r));
+      fflush(stdout);
+    }
+
+    if(json_name != "") write_json(json_name, results);
+  }
+  catch(const std::exception& e){
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
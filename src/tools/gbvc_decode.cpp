@@ -0,0 +1,141 @@
+#include "../utils/video_capture.h"
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/*
+ * Converts a capture file produced with `--capture` into a raw RGB24 stream,
+ * with one frame per emulated frame (repeated frames are expanded). The output
+ * can be played with:
+ *
+ *  ffplay -f rawvideo -pixel_format rgb24 -video_size 160x144 -framerate 60 out.rgb
+ * */
+
+/** read_u32
+    Read a little-endian 32-bit integer from a stream
+
+    @param stream std::ifstream& input stream
+    @return uint32_t read value
+
+*/
+static uint32_t read_u32(std::ifstream& stream){
+  uint8_t bytes[4] = {0, 0, 0, 0};
+  stream.read((char*)bytes, 4);
+  return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+/** decode_rle
+    Decode an RLE record into an array of pixels
+
+    @param data const std::vector<uint8_t>& encoded record
+    @param pixels std::vector<uint32_t>& decoded pixels
+    @return bool false if the record is malformed
+
+*/
+static bool decode_rle(const std::vector<uint8_t>& data, std::vector<uint32_t>& pixels){
+
+  size_t in = 0;
+  size_t out = 0;
+
+  auto get_pixel = [&](uint32_t& pixel){
+    if(in + VIDEO_CAPTURE_BYTES_PER_PIXEL > data.size()) return false;
+    pixel = (data[in] << 16) | (data[in + 1] << 8) | data[in + 2];
+    in += VIDEO_CAPTURE_BYTES_PER_PIXEL;
+    return true;
+  };
+
+  while(in < data.size()){
+    uint8_t header = data[in++];
+    uint32_t pixel;
+
+    if(header >= 0x80){
+      if(!get_pixel(pixel)) return false;
+      for(int i = 0; i < header - 0x80 + 1; i++){
+        if(out == pixels.size()) return false;
+        pixels[out++] = pixel;
+      }
+    }
+    else{
+      for(int i = 0; i < header + 1; i++){
+        if(out == pixels.size() or !get_pixel(pixel)) return false;
+        pixels[out++] = pixel;
+      }
+    }
+  }
+
+  return out == pixels.size();
+}
+
+int main(int argc, char* argv[]){
+
+  if(argc != 3){
+    std::cerr << "Usage: ./gbvc_decode capture.gbvc output.rgb" << std::endl;
+    return 1;
+  }
+
+  std::ifstream input(argv[1], std::ios::binary);
+  std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+
+  if(!input.is_open() or !output.is_open()){
+    std::cerr << "Input or output file not opened correctly" << std::endl;
+    return 1;
+  }
+
+  char magic[4];
+  uint8_t header[6];
+  input.read(magic, 4);
+  input.read((char*)header, 6);
+
+  if(!input or memcmp(magic, VIDEO_CAPTURE_MAGIC, 4) != 0 or header[0] != VIDEO_CAPTURE_VERSION){
+    std::cerr << "Not a valid capture file" << std::endl;
+    return 1;
+  }
+
+  uint16_t width  = header[1] | (header[2] << 8);
+  uint16_t height = header[3] | (header[4] << 8);
+
+  std::vector<uint32_t> frame(width * height, 0);
+  std::vector<uint32_t> decoded(width * height, 0);
+  std::vector<uint8_t>  record;
+  std::vector<uint8_t>  rgb(width * height * 3);
+  uint32_t frames = 0;
+
+  auto write_frame = [&](){
+    for(size_t i = 0; i < frame.size(); i++){
+      rgb[i * 3    ] = (frame[i] >> 16) & 0xff;
+      rgb[i * 3 + 1] = (frame[i] >>  8) & 0xff;
+      rgb[i * 3 + 2] = (frame[i] >>  0) & 0xff;
+    }
+    output.write((const char*)rgb.data(), rgb.size());
+    frames++;
+  };
+
+  int type;
+  while((type = input.get()) != EOF){
+
+    uint32_t value = read_u32(input);
+
+    if(type == VIDEO_CAPTURE_REPEAT_FRAME){
+      for(uint32_t i = 0; i < value; i++) write_frame();
+      continue;
+    }
+
+    record.resize(value);
+    input.read((char*)record.data(), value);
+
+    if(!input or (type != VIDEO_CAPTURE_KEY_FRAME and type != VIDEO_CAPTURE_DELTA_FRAME) or !decode_rle(record, decoded)){
+      std::cerr << "Corrupted capture file after " << frames << " frames" << std::endl;
+      return 1;
+    }
+
+    for(size_t i = 0; i < frame.size(); i++)
+      frame[i] = (type == VIDEO_CAPTURE_KEY_FRAME) ? decoded[i] : frame[i] ^ decoded[i];
+
+    write_frame();
+  }
+
+  std::cout << frames << " frames decoded (" << width << "x" << height << ")" << std::endl;
+  return 0;
+}
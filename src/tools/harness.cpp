@@ -0,0 +1,248 @@
+#include "../gameboy.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/wait.h>
+
+/*
+ * Golden harness: runs several roms headlessly and compares the hashes of
+ * every frame with the stored baselines. The manifest contains one test per
+ * line ('#' starts a comment):
+ *
+ *    path/to/rom frames path/to/baseline [path/to/input_script]
+ *
+ * Relative paths are resolved from the directory of the manifest. Each test
+ * runs in its own process, so that the global state of the emulator is not
+ * shared, and up to `-j N` tests run at the same time.
+ *
+ *    ./gbharness [--record] [-j N] manifest.txt
+ *
+ * With `--record` the baselines are (re)generated instead of checked.
+ * */
+
+struct Harness_test {
+  std::string rom;
+  uint32_t    frames;
+  std::string baseline;
+  std::string input;
+};
+
+struct Harness_job {
+  size_t test;
+  FILE*  log;
+};
+
+/** resolve_path
+    Resolves a path of the manifest with the respect to the manifest directory
+
+    @param directory const std::string& directory of the manifest, with trailing '/'
+    @param path const std::string& path as written in the manifest
+    @return std::string usable path
+
+*/
+static std::string resolve_path(const std::string& directory, const std::string& path){
+  if(path.empty() or path[0] == '/') return path;
+  return directory + path;
+}
+
+/** load_manifest
+    Parse the manifest file
+
+    @param file_name std::string path of the manifest
+    @return std::vector<Harness_test> tests to run
+
+*/
+static std::vector<Harness_test> load_manifest(std::string file_name){
+
+  std::ifstream manifest(file_name);
+  if(!manifest.is_open())
+    throw std::invalid_argument("Unable to open manifest " + file_name);
+
+  size_t slash = file_name.find_last_of('/');
+  std::string directory = (slash == std::string::npos) ? "" : file_name.substr(0, slash + 1);
+
+  std::vector<Harness_test> tests;
+  std::string line;
+
+  while(std::getline(manifest, line)){
+    line = line.substr(0, line.find('#'));
+    std::istringstream tokens(line);
+    Harness_test test;
+    if(!(tokens >> test.rom)) continue;
+    if(!(tokens >> test.frames >> test.baseline))
+      throw std::invalid_argument("Malformed manifest line: " + line);
+    tokens >> test.input;
+    test.rom = resolve_path(directory, test.rom);
+    test.baseline = resolve_path(directory, test.baseline);
+    test.input = resolve_path(directory, test.input);
+    tests.push_back(test);
+  }
+
+  return tests;
+}
+
+/** run_test
+    Body of the child process: it runs one test and exits with the gameboy status
+
+    @param test const Harness_test& test to run
+    @param record bool true to record the baseline
+
+*/
+static void run_test(const Harness_test& test, bool record){
+
+  int status = 1;
+
+  try{
+    gb_cli_args_t args;
+    args.rom_file_name = test.rom;
+    args.fixed_fps = false;
+    args.headless = true;
+    args.max_frames = test.frames;
+    args.capture_file_name = "";
+    args.audio_file_name = "";
+    args.audio_stems = false;
+    args.input_file_name = test.input;
+    args.hash_file_name = test.baseline;
+    args.hash_record = record;
+    args.no_save = true;
+    args.mmap_save = false;
+    args.sample_rate = GB_DEFAULT_SAMPLE_RATE;
+    args.audio_latency = GB_DEFAULT_AUDIO_LATENCY;
+    args.speed = 1;
+    args.profile_file_name = "";
+    args.perf_file_name = "";
+    args.stats_socket_name = "";
+
+    Gameboy gb(args);
+    status = gb.run();
+  }
+  catch(const std::exception& e){
+    std::cerr << e.what() << std::endl;
+  }
+
+  std::cout.flush();
+  std::cerr.flush();
+  _exit(status);
+}
+
+/** read_log
+    Provides the last line written by a test, which describes the failure
+
+    @param log FILE* output of the child process
+    @return std::string last non-empty line
+
+*/
+static std::string read_log(FILE* log){
+  std::string line, last;
+  char buffer[256];
+  rewind(log);
+  while(fgets(buffer, sizeof(buffer), log)){
+    line += buffer;
+    if(line.back() != '\n') continue;
+    line.pop_back();
+    if(!line.empty()) last = line;
+    line.clear();
+  }
+  if(!line.empty()) last = line;
+  fclose(log);
+  return last;
+}
+
+int main(int argc, char* argv[]){
+
+  bool record = false;
+  size_t jobs = 1;
+  std::string manifest_name = "";
+
+  const std::string usage = "Usage: ./gbharness [--record] [-j N] manifest.txt";
+
+  for(int i = 1; i < argc; i++){
+    std::string current_argv = argv[i];
+    if(current_argv == "--record")        record = true;
+    else if(current_argv == "-j" and i + 1 < argc) jobs = parse_unsigned(current_argv, argv[++i], usage, 1);
+    else manifest_name = current_argv;
+  }
+
+  if(manifest_name == ""){
+    std::cerr << usage << std::endl;
+    return 1;
+  }
+
+  std::vector<Harness_test> tests;
+  try{
+    tests = load_manifest(manifest_name);
+  }
+  catch(const std::exception& e){
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  std::map<pid_t, Harness_job> running;
+  size_t next_test = 0;
+  size_t failures = 0;
+
+  while(next_test < tests.size() or !running.empty()){
+
+    // Start new tests while there are free slots
+    if(next_test < tests.size() and running.size() < jobs){
+      FILE* log = tmpfile();
+      if(!log){
+        std::cerr << "Unable to create the log of a test" << std::endl;
+        return 1;
+      }
+
+      // Buffered output would be duplicated in the child
+      std::cout.flush();
+      fflush(stdout);
+
+      pid_t pid = fork();
+      if(pid < 0){
+        std::cerr << "Unable to start a test" << std::endl;
+        return 1;
+      }
+      if(pid == 0){
+        dup2(fileno(log), STDOUT_FILENO);
+        dup2(fileno(log), STDERR_FILENO);
+        run_test(tests[next_test], record);
+      }
+
+      running[pid] = {next_test++, log};
+      continue;
+    }
+
+    // Wait for a test to complete
+    int status;
+    pid_t pid = wait(&status);
+    if(pid < 0) break;
+    if(running.count(pid) == 0) continue;
+
+    Harness_job job = running[pid];
+    running.erase(pid);
+
+    const Harness_test& test = tests[job.test];
+    std::string last_line = read_log(job.log);
+    int exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+    if(exit_code == 0){
+      std::cout << "[PASS] " << test.rom << " (" << test.frames << " frames)" << std::endl;
+      continue;
+    }
+
+    failures++;
+    if(exit_code == GAMEBOY_DIVERGED)
+      std::cout << "[DIFF] " << test.rom << ": " << last_line << std::endl;
+    else
+      std::cout << "[FAIL] " << test.rom << ": " << (last_line.empty() ? "crashed" : last_line) << std::endl;
+  }
+
+  std::cout << tests.size() - failures << "/" << tests.size() << " tests "
+            << (record ? "recorded" : "passed") << std::endl;
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,621 @@
+#include "../gameboy.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+/*
+ * Microbenchmarks of the hot primitives of the emulator, measured in
+ * isolation: the bus accesses to each region of the memory map, the CPU
+ * step for each class of opcodes, the PPU over a scanline with and without
+ * objects, the conversion of the CGB colors and the APU run in blocks.
+ *
+ * Each benchmark runs a batch of operations for some warm-up repetitions,
+ * then it times each of the following repetitions, and the nanoseconds per
+ * operation are reported as minimum, median and percentiles.
+ *
+ *    ./gbmicrobench [--repetitions N] [--json path] [prefix ...]
+ *
+ * Only the benchmarks whose name starts with one of the prefixes are run.
+ * */
+
+#define MICROBENCH_DEFAULT_REPETITIONS 101
+#define MICROBENCH_WARMUP              10
+
+// Operations timed together: a single bus access is too short for the clock
+#define MICROBENCH_BATCH               4096
+
+// M-cycles of the CPU performed in each repetition
+#define MICROBENCH_CPU_STEPS           65536
+
+// PPU lines measured in each repetition: those with the objects on them
+#define MICROBENCH_PPU_LINES           7
+#define MICROBENCH_PPU_LINE_CYCLES     456
+
+// T-cycles of a frame, run by the APU in each repetition
+#define MICROBENCH_FRAME_CYCLES        70224u
+
+extern struct gb_global_t gb_global;
+
+// Results are accumulated here, so that the measured code is not optimized away
+static volatile uint32_t sink;
+
+struct Micro_result {
+  std::string         name;
+  std::string         unit;
+  std::vector<double> samples;
+};
+
+/** percentile
+    @param sorted const std::vector<double>& samples in increasing order
+    @param p double percentile, from 0 to 100
+    @return double sample at the given percentile (nearest rank)
+
+*/
+static double percentile(const std::vector<double>& sorted, double p){
+  size_t rank = (size_t) (p / 100 * (sorted.size() - 1) + 0.5);
+  return sorted[rank];
+}
+
+/** collect
+    Run a benchmark: `body` performs a repetition and returns the mean time
+    of its operations, which is a sample
+
+    @param name std::string name of the benchmark
+    @param unit std::string operation measured
+    @param repetitions uint32_t number of timed repetitions
+    @param body Body function performing a repetition
+    @return Micro_result samples, in increasing order
+
+*/
+template<class Body>
+static Micro_result collect(std::string name, std::string unit, uint32_t repetitions, Body body){
+
+  Micro_result result = {name, unit, {}};
+
+  for(uint32_t i = 0; i < MICROBENCH_WARMUP; i++) body();
+  for(uint32_t i = 0; i < repetitions; i++) result.samples.push_back(body());
+
+  std::sort(result.samples.begin(), result.samples.end());
+  return result;
+}
+
+/** measure
+    Run a benchmark timing the whole repetition: `body` performs it and
+    returns the number of operations it performed
+
+    @param name std::string name of the benchmark
+    @param unit std::string operation measured
+    @param repetitions uint32_t number of timed repetitions
+    @param body Body function performing a repetition
+    @return Micro_result samples, in increasing order
+
+*/
+template<class Body>
+static Micro_result measure(std::string name, std::string unit, uint32_t repetitions, Body body){
+  return collect(name, unit, repetitions, [&](){
+    auto start = std::chrono::steady_clock::now();
+    uint64_t operations = body();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return operations ? elapsed.count() / operations : 0;
+  });
+}
+
+/*
+ * 64 KB of plain memory, in place of the bus, so that the CPU
+ * benchmarks only measure the fetch, decode and execution.
+ * */
+class Flat_memory : public Bus_obj {
+
+  std::vector<uint8_t> memory;
+
+public:
+
+  Flat_memory() : Bus_obj("FLAT", 0, 0xFFFF), memory(0x10000, 0) {}
+  uint8_t read(uint16_t addr){ return memory[addr]; }
+  void    write(uint16_t addr, uint8_t data){ memory[addr] = data; }
+  void    step(Bus_obj*){}
+};
+
+/*
+ * The components of the memory map, connected to a bus as in the Gameboy,
+ * without CPU and with a temporary CGB rom (MBC5 with 8 KB of RAM).
+ * */
+struct Rig {
+  Bus*       bus;
+  Cartridge* cart;
+  WRAM*      wram;
+  CRAM*      cram;
+  Memory*    oam;
+  PPU*       ppu;
+  APU*       apu;
+  Timer*     timer;
+  Memory*    hram;
+  Register*  if_reg;
+  Register*  ie_reg;
+  Register*  brom_en;
+  Register*  svbk_reg;
+  Register*  vbk_reg;
+  Audio_capture* audio_capture;
+};
+
+/** create_rom
+    Write a rom of two banks with an empty program in a temporary file
+
+    @return std::string path of the file
+
+*/
+static std::string create_rom(){
+
+  std::vector<uint8_t> content(0x8000, 0);
+  content[0x143] = 0x80;
+  content[0x147] = 0x1a;
+  content[0x148] = 0x00;
+  content[0x149] = 0x02;
+  for(size_t i = 0x4000; i < content.size(); i++) content[i] = i & 0xff;
+
+  char rom_name[] = "/tmp/gbmicrobench_XXXXXX";
+  int file = mkstemp(rom_name);
+  if(file < 0) throw std::runtime_error("Unable to create the rom");
+  bool written = write(file, content.data(), content.size()) == (ssize_t) content.size();
+  close(file);
+  if(!written){
+    unlink(rom_name);
+    throw std::runtime_error("Unable to write the rom");
+  }
+  return rom_name;
+}
+
+/** create_rig
+    Create and connect the components, then prepare the tiles, the palettes
+    and the audio channels used by the benchmarks
+
+    @return Rig components
+
+*/
+static Rig create_rig(){
+
+  Rig rig;
+
+  gb_global.headless = 1;
+  gb_global.fixed_fps = 0;
+  gb_global.speed = 1;
+  gb_global.sample_rate = GB_DEFAULT_SAMPLE_RATE;
+  gb_global.audio_latency = GB_DEFAULT_AUDIO_LATENCY;
+  gb_global.double_speed = 0;
+  gb_global.exit_request = 0;
+  gb_global.frame_ready = 0;
+  gb_global.volume_amplification = JOYPAD_MAX_VOLUME;
+
+  std::string rom_name = create_rom();
+  rig.bus = new Bus("BUS", 0, 0xFFFF, BUS_FREQUENCY);
+  rig.cart = new Cartridge("CART", MMU_CART_INIT_ADDR, MMU_CART_SIZE);
+  rig.cart->set_save_enabled(false);
+  try{
+    rig.cart->init_from_file(rom_name);
+  }
+  catch(...){
+    unlink(rom_name.c_str());
+    throw;
+  }
+  unlink(rom_name.c_str());
+
+  rig.wram = new WRAM(          "WRAM",       MMU_WRAM_INIT_ADDR,       MMU_WRAM_SIZE                             );
+  rig.cram = new CRAM(          "CRAM",       MMU_CRAM_INIT_ADDR,       MMU_CRAM_SIZE                             );
+  rig.oam = new Memory(         "OAM",        MMU_OAM_INIT_ADDR,        MMU_OAM_SIZE                              );
+  rig.timer = new Timer(        "TIMER",      MMU_TIMER_INIT_ADDR                                                 );
+  rig.ppu = new PPU(            "PPU",        MMU_PPU_INIT_ADDR                                                   );
+  rig.apu = new APU(            "APU",        MMU_APU_INIT_ADDR                                                   );
+  rig.brom_en = new Register(   "BROM_EN",    MMU_BROM_EN_INIT_ADDR,    MMU_BROM_EN_SIZE                          );
+  rig.hram = new Memory(        "HRAM",       MMU_HRAM_INIT_ADDR,       MMU_HRAM_SIZE                             );
+  rig.ie_reg = new Register(    "IE_REG",     MMU_IE_REG_INIT_ADDR,     MMU_IE_REG_SIZE,    MMU_IE_REG_INIT_VAL   );
+  rig.if_reg = new Register(    "IF_REG",     MMU_IF_REG_INIT_ADDR,     MMU_IF_REG_SIZE,    MMU_IF_REG_INIT_VAL   );
+  rig.svbk_reg = new Register(  "SVBK_REG",   MMU_SVBK_REG_INIT_ADDR,   MMU_SVBK_REG_SIZE,  MMU_SVBK_REG_INIT_VAL );
+  rig.vbk_reg = new Register(   "VBK_REG",    MMU_VBK_REG_INIT_ADDR,    MMU_VBK_REG_SIZE,   MMU_VBK_REG_INIT_VAL  );
+
+  rig.timer->set_frequency(TIMER_FREQUENCY);
+  rig.ppu->set_frequency(PPU_FREQUENCY);
+  rig.apu->set_frequency(APU_FREQUENCY);
+
+  rig.bus->add_to_bus(rig.cart);
+  rig.bus->add_to_bus(rig.wram);
+  rig.bus->add_to_bus(rig.cram);
+  rig.bus->add_to_bus(rig.oam);
+  rig.bus->add_to_bus(rig.ppu);
+  rig.bus->add_to_bus(rig.apu);
+  rig.bus->add_to_bus(rig.timer);
+  rig.bus->add_to_bus(rig.if_reg);
+  rig.bus->add_to_bus(rig.brom_en);
+  rig.bus->add_to_bus(rig.hram);
+  rig.bus->add_to_bus(rig.ie_reg);
+  rig.bus->add_to_bus(rig.svbk_reg);
+  rig.bus->add_to_bus(rig.vbk_reg);
+
+  rig.ppu->set_io_handlers(rig.bus);
+  rig.apu->set_io_handlers(rig.bus);
+  rig.timer->set_io_handlers(rig.bus);
+
+  rig.bus->add_sync_dependency(rig.cart, rig.ppu, false);
+  rig.bus->add_sync_dependency(rig.oam,  rig.ppu, false);
+  rig.bus->add_sync_dependency(rig.cram, rig.ppu, false);
+  rig.bus->add_sync_dependency(rig.timer, rig.apu, false);
+  rig.timer->apu = rig.apu;
+  rig.timer->_bus_to_sync = rig.bus;
+
+  rig.vbk_reg->add_listener(rig.cart);
+  rig.brom_en->add_listener(rig.cart);
+  rig.svbk_reg->add_listener(rig.wram);
+
+  rig.ppu->cart = rig.cart;
+  rig.ppu->cram = rig.cram;
+  rig.ppu->oam = rig.oam;
+
+  // The APU synthesizes the waveforms only when its output is used
+  rig.audio_capture = new Audio_capture("/dev/null", rig.apu->get_sample_rate(), 2);
+  rig.apu->set_audio_capture(rig.audio_capture);
+
+  // Unmap the boot rom and enable the cartridge RAM
+  rig.bus->write(MMU_BROM_EN_INIT_ADDR, 0x01);
+  rig.bus->write(0x0000, 0x0a);
+
+  // Tiles and maps in both the VRAM banks
+  for(uint8_t bank = 0; bank < 2; bank++){
+    rig.bus->write(MMU_VBK_REG_INIT_ADDR, bank);
+    for(uint32_t addr = 0x8000; addr < 0xa000; addr++) rig.bus->write(addr, (addr * 13) ^ (addr >> 8));
+  }
+  rig.bus->write(MMU_VBK_REG_INIT_ADDR, 0);
+
+  // All the palettes, through the auto-incrementing BCPS and OCPS
+  rig.bus->write(0xff68, 0x80);
+  rig.bus->write(0xff6a, 0x80);
+  for(uint32_t i = 0; i < 64; i++){
+    rig.bus->write(0xff69, i * 37);
+    rig.bus->write(0xff6b, i * 91);
+  }
+
+  // All the audio channels on, without length
+  std::vector<std::pair<uint16_t, uint8_t>> registers = {
+    {0xff26, 0x80}, {0xff24, 0x77}, {0xff25, 0xff}, {0xff10, 0x17}, {0xff11, 0x80}, {0xff12, 0xf3}, {0xff13, 0x00},
+    {0xff14, 0x87}, {0xff16, 0x40}, {0xff17, 0xa7}, {0xff18, 0x80}, {0xff19, 0x86}, {0xff1a, 0x80}, {0xff1c, 0x20},
+    {0xff1d, 0x40}, {0xff1e, 0x86}, {0xff21, 0xf1}, {0xff22, 0x31}, {0xff23, 0x80}
+  };
+  for(uint16_t i = 0; i < 16; i++) rig.bus->write(0xff30 + i, i * 0x11 + 0x37);
+  for(auto& reg : registers) rig.bus->write(reg.first, reg.second);
+
+  return rig;
+}
+
+/** delete_rig
+    @param rig Rig& components to deallocate
+
+*/
+static void delete_rig(Rig& rig){
+  delete rig.bus;
+  delete rig.audio_capture;
+  delete rig.cart;
+  delete rig.wram;
+  delete rig.cram;
+  delete rig.oam;
+  delete rig.ppu;
+  delete rig.apu;
+  delete rig.timer;
+  delete rig.hram;
+  delete rig.if_reg;
+  delete rig.ie_reg;
+  delete rig.brom_en;
+  delete rig.svbk_reg;
+  delete rig.vbk_reg;
+}
+
+/** bench_bus
+    Reads and writes through the bus, for each region of the memory map
+
+    @param rig Rig& components
+    @param repetitions uint32_t number of timed repetitions
+    @param results std::vector<Micro_result>& where the results are added
+
+*/
+static void bench_bus(Rig& rig, uint32_t repetitions, std::vector<Micro_result>& results){
+
+  struct Region { std::string name; uint16_t addr; uint16_t mask; bool writable; };
+
+  // The registers at 0xFF42 (SCY) and 0xFF4F (VBK) are reached through the IO
+  // table, the first directly and the second through the generic handler
+  const std::vector<Region> regions = {
+    {"rom0",      0x0150, 0x0fff, false},
+    {"romx",      0x4000, 0x0fff, false},
+    {"vram",      0x8000, 0x0fff, true },
+    {"sram",      0xa000, 0x0fff, true },
+    {"wram0",     0xc000, 0x0fff, true },
+    {"wramx",     0xd000, 0x0fff, true },
+    {"oam",       0xfe00, 0x007f, true },
+    {"io_direct", 0xff42, 0x0000, true },
+    {"io_object", 0xff4f, 0x0000, true },
+    {"hram",      0xff80, 0x003f, true },
+    {"ie",        0xffff, 0x0000, true },
+  };
+
+  Bus* bus = rig.bus;
+
+  for(auto& region : regions){
+    results.push_back(measure("bus_read_" + region.name, "read", repetitions, [&](){
+      uint32_t sum = 0;
+      for(uint32_t i = 0; i < MICROBENCH_BATCH; i++) sum += bus->read(region.addr + (i & region.mask));
+      sink = sum;
+      return (uint64_t) MICROBENCH_BATCH;
+    }));
+  }
+
+  for(auto& region : regions){
+    if(!region.writable) continue;
+    results.push_back(measure("bus_write_" + region.name, "write", repetitions, [&](){
+      for(uint32_t i = 0; i < MICROBENCH_BATCH; i++) bus->write(region.addr + (i & region.mask), i & 0x01);
+      return (uint64_t) MICROBENCH_BATCH;
+    }));
+  }
+
+  // Writes to the rom select the bank
+  results.push_back(measure("bus_write_mbc", "write", repetitions, [&](){
+    for(uint32_t i = 0; i < MICROBENCH_BATCH; i++) bus->write(0x2000, 1);
+    return (uint64_t) MICROBENCH_BATCH;
+  }));
+}
+
+/** bench_cpu
+    Steps of the CPU running a loop made of a single class of opcodes.
+    The CPU reads from plain memory, instead of the bus
+
+    @param repetitions uint32_t number of timed repetitions
+    @param results std::vector<Micro_result>& where the results are added
+
+*/
+static void bench_cpu(uint32_t repetitions, std::vector<Micro_result>& results){
+
+  struct Opcode_class { std::string name; std::vector<uint8_t> body; };
+
+  const std::vector<Opcode_class> classes = {
+    {"nop",      {0x00}},                                                 // nop
+    {"ld_r_r",   {0x41, 0x4a, 0x53, 0x5c, 0x65, 0x6f}},                   // ld b,c ; ld c,d ; ld d,e ; ld e,h ; ld h,l ; ld l,a
+    {"ld_r_hl",  {0x7e, 0x77, 0x46, 0x70}},                               // ld a,(hl) ; ld (hl),a ; ld b,(hl) ; ld (hl),b
+    {"ld_r_n",   {0x3e, 0x12, 0x06, 0x34, 0x0e, 0x56}},                   // ld a,n ; ld b,n ; ld c,n
+    {"alu_x8",   {0x80, 0x89, 0xaa, 0xa3, 0xb4, 0x93, 0xbd, 0x3c}},       // add b ; adc c ; xor d ; and e ; or h ; sub e ; cp l ; inc a
+    {"alu_x16",  {0x03, 0x13, 0x09, 0x1b, 0x0b, 0x33, 0x3b}},             // inc bc ; inc de ; add hl,bc ; dec de ; dec bc ; inc sp ; dec sp
+    {"stack",    {0xc5, 0xd1, 0xe5, 0xf1}},                               // push bc ; pop de ; push hl ; pop af
+    {"jr",       {0x18, 0x00, 0x20, 0x00, 0x38, 0x00}},                   // jr +0 ; jr nz,+0 ; jr c,+0
+    {"cb",       {0xcb, 0x11, 0xcb, 0x3f, 0xcb, 0x30, 0xcb, 0x47}},       // rl c ; srl a ; swap b ; bit 0,a
+  };
+
+  for(auto& opcode_class : classes){
+
+    // ld hl,$c000, then the body repeated up to the end of the bank and a jump back
+    Flat_memory memory;
+    uint16_t addr = 0;
+    for(uint8_t byte : {0x21, 0x00, 0xc0}) memory.write(addr++, byte);
+    while(addr + opcode_class.body.size() < 0x3ffd) for(uint8_t byte : opcode_class.body) memory.write(addr++, byte);
+    for(uint8_t byte : {0xc3, 0x03, 0x00}) memory.write(addr++, byte);
+
+    Cpu cpu("CPU", CPU_FREQUENCY);
+
+    results.push_back(measure("cpu_" + opcode_class.name, "instruction", repetitions, [&](){
+      uint64_t instructions = cpu.get_instructions();
+      for(uint32_t i = 0; i < MICROBENCH_CPU_STEPS; i++) cpu.step(&memory);
+      return cpu.get_instructions() - instructions;
+    }));
+  }
+}
+
+/** bench_ppu
+    A scanline of the PPU (OAM scan, drawing and HBLANK) on the lines with
+    no object or with 10 objects. The lines are run through PPU::run, as
+    the bus does, since the modes cannot be stepped on their own
+
+    @param rig Rig& components
+    @param repetitions uint32_t number of timed repetitions
+    @param results std::vector<Micro_result>& where the results are added
+
+*/
+static void bench_ppu(Rig& rig, uint32_t repetitions, std::vector<Micro_result>& results){
+
+  Bus* bus = rig.bus;
+  PPU* ppu = rig.ppu;
+
+  for(uint32_t objects : {0, 10}){
+
+    // Objects of 8x8 pixels on the first lines, spread along them
+    for(uint16_t i = 0; i < 40; i++){
+      bus->write(0xfe00 + i * 4,     i < objects ? 16 : 0);
+      bus->write(0xfe00 + i * 4 + 1, 8 + i * 16);
+      bus->write(0xfe00 + i * 4 + 2, i);
+      bus->write(0xfe00 + i * 4 + 3, i & 0x2f);
+    }
+
+    // LCD on with background, objects and window
+    bus->write(0xff4a, 80);
+    bus->write(0xff4b, 87);
+    bus->write(0xff40, 0xf3);
+
+    // The frame is run line by line, and only the lines with the objects are timed
+    results.push_back(collect("ppu_line_" + std::to_string(objects) + "_objects", "line", repetitions, [&](){
+      std::chrono::duration<double, std::nano> timed(0);
+      uint32_t lines = 0;
+      while(lines < MICROBENCH_PPU_LINES){
+        if(bus->read(0xff44) < MICROBENCH_PPU_LINES){
+          auto start = std::chrono::steady_clock::now();
+          ppu->run(bus, MICROBENCH_PPU_LINE_CYCLES);
+          timed += std::chrono::steady_clock::now() - start;
+          lines++;
+        }
+        else ppu->run(bus, MICROBENCH_PPU_LINE_CYCLES);
+      }
+      return timed.count() / MICROBENCH_PPU_LINES;
+    }));
+  }
+
+  bus->write(0xff40, 0x00);
+}
+
+/** bench_cram
+    Conversion of the CGB colors, done by the PPU for each pixel
+
+    @param rig Rig& components
+    @param repetitions uint32_t number of timed repetitions
+    @param results std::vector<Micro_result>& where the results are added
+
+*/
+static void bench_cram(Rig& rig, uint32_t repetitions, std::vector<Micro_result>& results){
+
+  CRAM* cram = rig.cram;
+
+  results.push_back(measure("cram_read_color_palette", "color", repetitions, [&](){
+    uint32_t sum = 0;
+    for(uint32_t i = 0; i < MICROBENCH_BATCH; i++)
+      sum += cram->read_color_palette(i & 0x01, (i >> 1) & 0x07, (i >> 4) & 0x03);
+    sink = sum;
+    return (uint64_t) MICROBENCH_BATCH;
+  }));
+}
+
+/** bench_apu
+    The APU with all the channels on and the waveforms synthesized, run in
+    blocks as the bus catches it up: a scanline, the longest block the bus
+    leaves pending (APU_MAX_RUN_CYCLES), and a whole frame at once, which
+    shows the cost left once the work per block is amortized. Each
+    repetition runs a frame worth of T-cycles
+
+    @param rig Rig& components
+    @param repetitions uint32_t number of timed repetitions
+    @param results std::vector<Micro_result>& where the results are added
+
+*/
+static void bench_apu(Rig& rig, uint32_t repetitions, std::vector<Micro_result>& results){
+
+  Bus* bus = rig.bus;
+  APU* apu = rig.apu;
+
+  struct Apu_block { std::string name; uint32_t cycles; };
+
+  const std::vector<Apu_block> blocks = {
+    {"apu_run_" + std::to_string(MICROBENCH_PPU_LINE_CYCLES), MICROBENCH_PPU_LINE_CYCLES},
+    {"apu_run_" + std::to_string(APU_MAX_RUN_CYCLES),         APU_MAX_RUN_CYCLES},
+    {"apu_run_" + std::to_string(MICROBENCH_FRAME_CYCLES),    MICROBENCH_FRAME_CYCLES},
+  };
+
+  for(auto& block : blocks){
+    results.push_back(measure(block.name, "T-cycle", repetitions, [&](){
+      for(uint32_t done = 0; done < MICROBENCH_FRAME_CYCLES;){
+        uint32_t cycles = std::min(block.cycles, MICROBENCH_FRAME_CYCLES - done);
+        apu->run(bus, cycles);
+        done += cycles;
+      }
+      return (uint64_t) MICROBENCH_FRAME_CYCLES;
+    }));
+  }
+}
+
+/** write_json
+    Write the results in a JSON file
+
+    @param file_name std::string path of the file
+    @param repetitions uint32_t number of timed repetitions
+    @param results const std::vector<Micro_result>& results to write
+
+*/
+static void write_json(std::string file_name, uint32_t repetitions, const std::vector<Micro_result>& results){
+
+  std::ofstream file(file_name);
+  if(!file.is_open()) throw std::invalid_argument("Unable to create JSON file " + file_name);
+
+  file << "{\n  \"repetitions\": " << repetitions << ",\n  \"benchmarks\": [";
+  for(size_t i = 0; i < results.size(); i++){
+    const Micro_result& r = results[i];
+    file << (i ? ",\n" : "\n") << "    {\"name\": \"" << r.name << "\""
+         << ", \"unit\": \"" << r.unit << "\""
+         << ", \"min_ns\": "    << r.samples.front()
+         << ", \"median_ns\": " << percentile(r.samples, 50)
+         << ", \"p90_ns\": "    << percentile(r.samples, 90)
+         << ", \"p99_ns\": "    << percentile(r.samples, 99)
+         << ", \"max_ns\": "    << r.samples.back() << "}";
+  }
+  file << "\n  ]\n}\n";
+}
+
+/** has_prefix
+    @param name std::string name of a benchmark
+    @param prefixes const std::vector<std::string>& prefixes given by the user
+    @return bool whether the name starts with one of the prefixes (true without prefixes)
+
+*/
+static bool has_prefix(std::string name, const std::vector<std::string>& prefixes){
+  if(prefixes.empty()) return true;
+  for(auto& prefix : prefixes) if(name.compare(0, prefix.size(), prefix) == 0) return true;
+  return false;
+}
+
+/** is_selected
+    @param group std::string group of benchmarks, the first part of their names
+    @param prefixes const std::vector<std::string>& prefixes given by the user
+    @return bool whether some benchmark of the group is to run
+
+*/
+static bool is_selected(std::string group, const std::vector<std::string>& prefixes){
+  if(has_prefix(group, prefixes)) return true;
+  for(auto& prefix : prefixes) if(prefix.compare(0, group.size(), group) == 0) return true;
+  return false;
+}
+
+int main(int argc, char* argv[]){
+
+  uint32_t repetitions = MICROBENCH_DEFAULT_REPETITIONS;
+  std::string json_name = "";
+  std::vector<std::string> prefixes;
+
+  const std::string usage = "Usage: ./gbmicrobench [--repetitions N] [--json path] [prefix ...]";
+
+  for(int i = 1; i < argc; i++){
+    std::string current_argv = argv[i];
+    if(current_argv == "--repetitions" and i + 1 < argc) repetitions = parse_unsigned(current_argv, argv[++i], usage, 1);
+    else if(current_argv == "--json" and i + 1 < argc)   json_name = argv[++i];
+    else if(current_argv == "--help"){
+      std::cout << usage << std::endl;
+      std::cout << "Groups: bus cpu ppu cram apu" << std::endl;
+      return 1;
+    }
+    else prefixes.push_back(current_argv);
+  }
+
+  std::vector<Micro_result> results;
+
+  try{
+    Rig rig = create_rig();
+
+    if(is_selected("bus",  prefixes)) bench_bus(rig, repetitions, results);
+    if(is_selected("cpu",  prefixes)) bench_cpu(repetitions, results);
+    if(is_selected("ppu",  prefixes)) bench_ppu(rig, repetitions, results);
+    if(is_selected("cram", prefixes)) bench_cram(rig, repetitions, results);
+    if(is_selected("apu",  prefixes)) bench_apu(rig, repetitions, results);
+
+    delete_rig(rig);
+
+    // The groups are run as a whole, then filtered by name
+    std::vector<Micro_result> selected;
+    for(auto& r : results) if(has_prefix(r.name, prefixes)) selected.push_back(r);
+
+    printf("%-26s %-12s %10s %10s %10s %10s\n", "benchmark", "unit", "min ns", "median ns", "p90 ns", "p99 ns");
+    for(auto& r : selected){
+      printf("%-26s %-12s %10.2f %10.2f %10.2f %10.2f\n", r.name.c_str(), r.unit.c_str(), r.samples.front(),
+             percentile(r.samples, 50), percentile(r.samples, 90), percentile(r.samples, 99));
+    }
+
+    if(json_name != "") write_json(json_name, repetitions, selected);
+  }
+  catch(const std::exception& e){
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
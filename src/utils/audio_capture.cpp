@@ -0,0 +1,123 @@
+#include "audio_capture.h"
+#include <stdexcept>
+
+/** Audio_capture::Audio_capture
+    Opens the capture file, writes a temporary header and starts the writer thread
+
+    @param file_name std::string Path of the WAV file
+    @param sample_rate uint32_t Samples per second of each channel
+    @param channels uint16_t Number of interleaved channels
+
+*/
+Audio_capture::Audio_capture(std::string file_name, uint32_t sample_rate, uint16_t channels) :
+  _queue(AUDIO_CAPTURE_QUEUE_SIZE){
+
+  _sample_rate = sample_rate;
+  _channels = channels;
+  _data_size = 0;
+
+  _stream.open(file_name, std::ios::binary | std::ios::trunc);
+  if(!_stream.is_open()){
+    throw std::invalid_argument("Audio capture file " + file_name + " not opened correctly.");
+  }
+
+  write_header();
+
+  _block.reserve(AUDIO_CAPTURE_BLOCK_SIZE);
+  _writer = std::thread(&Audio_capture::writer_loop, this);
+}
+
+/** Audio_capture::push_samples
+    Called by the emulation thread with the samples produced by the APU. They
+    are sent to the writer once a block is full
+
+    @param samples const int16_t* interleaved samples
+    @param count uint32_t number of samples
+
+*/
+void Audio_capture::push_samples(const int16_t* samples, uint32_t count){
+
+  for(uint32_t i = 0; i < count; i++){
+    _block.push_back(samples[i]);
+
+    if(_block.size() == AUDIO_CAPTURE_BLOCK_SIZE){
+      _queue.push(std::move(_block));
+      _block = std::vector<int16_t>();
+      _block.reserve(AUDIO_CAPTURE_BLOCK_SIZE);
+    }
+  }
+}
+
+/** Audio_capture::writer_loop
+    Body of the writer thread: writes the queued blocks until the queue is closed,
+    then completes the header
+
+*/
+void Audio_capture::writer_loop(){
+
+  std::vector<int16_t> block;
+
+  while(_queue.pop(block)){
+    for(int16_t sample : block) write_u16((uint16_t) sample);
+    _data_size += block.size() * sizeof(int16_t);
+  }
+
+  _stream.seekp(0);
+  write_header();
+}
+
+/** Audio_capture::write_header
+    Write the RIFF header, with the sizes of the data written so far
+
+*/
+void Audio_capture::write_header(){
+
+  _stream.write("RIFF", 4);
+  write_u32(AUDIO_CAPTURE_HEADER_SIZE - 8 + _data_size);
+  _stream.write("WAVE", 4);
+
+  // Format chunk: PCM, 16 bits per sample
+  _stream.write("fmt ", 4);
+  write_u32(16);
+  write_u16(1);
+  write_u16(_channels);
+  write_u32(_sample_rate);
+  write_u32(_sample_rate * _channels * sizeof(int16_t));
+  write_u16(_channels * sizeof(int16_t));
+  write_u16(16);
+
+  _stream.write("data", 4);
+  write_u32(_data_size);
+}
+
+/** Audio_capture::write_u16
+    Write a 16-bit little-endian integer
+
+    @param data uint16_t integer to write
+
+*/
+void Audio_capture::write_u16(uint16_t data){
+  _stream.put(data & 0xff);
+  _stream.put(data >> 8);
+}
+
+/** Audio_capture::write_u32
+    Write a 32-bit little-endian integer
+
+    @param data uint32_t integer to write
+
+*/
+void Audio_capture::write_u32(uint32_t data){
+  write_u16(data & 0xffff);
+  write_u16(data >> 16);
+}
+
+/** Audio_capture::~Audio_capture
+    Sends the last samples and waits for the writer thread to complete the file
+
+*/
+Audio_capture::~Audio_capture(){
+  if(!_block.empty()) _queue.push(std::move(_block));
+  _queue.close();
+  if(_writer.joinable()) _writer.join();
+}
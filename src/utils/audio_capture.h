@@ -0,0 +1,49 @@
+#ifndef __AUDIO_CAPTURE_H
+#define __AUDIO_CAPTURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include "bounded_queue.h"
+
+/*
+ * Audio capture in a WAV file (RIFF, 16-bit signed PCM, little-endian).
+ * The samples are interleaved, as produced by the APU. They are grouped in
+ * blocks of AUDIO_CAPTURE_BLOCK_SIZE samples, which are written by a
+ * background thread; the sizes in the header are filled once the capture
+ * is completed.
+ * */
+#define AUDIO_CAPTURE_BLOCK_SIZE  8192
+#define AUDIO_CAPTURE_QUEUE_SIZE  32
+#define AUDIO_CAPTURE_HEADER_SIZE 44
+
+class Audio_capture {
+
+  uint32_t _sample_rate;
+  uint16_t _channels;
+
+  std::ofstream _stream;
+  std::thread   _writer;
+  Bounded_queue<std::vector<int16_t>> _queue;
+
+  // Block being filled by the emulation thread
+  std::vector<int16_t> _block;
+
+  // Bytes of samples written by the writer thread
+  uint32_t _data_size;
+
+  void writer_loop();
+  void write_header();
+  void write_u16(uint16_t);
+  void write_u32(uint32_t);
+
+public:
+
+  Audio_capture(std::string, uint32_t, uint16_t);
+  void push_samples(const int16_t*, uint32_t);
+  ~Audio_capture();
+};
+
+#endif // __AUDIO_CAPTURE_H
@@ -0,0 +1,73 @@
+#ifndef __BOUNDED_QUEUE_H
+#define __BOUNDED_QUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * Queue with a fixed capacity, used to move data from the emulation
+ * thread to a background writer thread. The producer blocks when the
+ * queue is full, the consumer blocks when the queue is empty. Once the
+ * queue is closed, the consumer drains the remaining elements and then
+ * `pop` returns false.
+ * */
+template <typename T>
+class Bounded_queue {
+
+  std::deque<T>           _elements;
+  std::size_t             _capacity;
+  bool                    _closed;
+  std::mutex              _mutex;
+  std::condition_variable _not_full;
+  std::condition_variable _not_empty;
+
+public:
+
+  Bounded_queue(std::size_t capacity) : _capacity(capacity), _closed(false) {}
+
+  /** Bounded_queue::push
+      Add an element to the queue, waiting for some space to be available
+
+      @param element T element to move in the queue
+      @return bool false if the queue was closed
+  */
+  bool push(T element){
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_full.wait(lock, [this]{ return _closed or _elements.size() < _capacity; });
+    if(_closed) return false;
+    _elements.push_back(std::move(element));
+    _not_empty.notify_one();
+    return true;
+  }
+
+  /** Bounded_queue::pop
+      Remove the oldest element of the queue, waiting for one to be available
+
+      @param element T& destination of the element
+      @return bool false if the queue is closed and empty
+  */
+  bool pop(T& element){
+    std::unique_lock<std::mutex> lock(_mutex);
+    _not_empty.wait(lock, [this]{ return _closed or !_elements.empty(); });
+    if(_elements.empty()) return false;
+    element = std::move(_elements.front());
+    _elements.pop_front();
+    _not_full.notify_one();
+    return true;
+  }
+
+  /** Bounded_queue::close
+      No more elements can be added; waiting threads are woken up
+
+  */
+  void close(){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _not_full.notify_all();
+    _not_empty.notify_all();
+  }
+};
+
+#endif // __BOUNDED_QUEUE_H
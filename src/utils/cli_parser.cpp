@@ -1,14 +1,94 @@
 #include "cli_parser.h"
+#include <cmath>
+#include <stdexcept>
 
+/** parse_number
+    Parses the value of a numeric argument. The whole string must be a finite
+    number, otherwise the argument is reported with the usage and the program exits
+
+    @param flag std::string name of the argument, for the error message
+    @param value std::string value given to the argument
+    @param helper_string std::string usage of the program
+    @return double parsed value
+
+*/
+static double parse_number(std::string flag, std::string value, std::string helper_string){
+
+  size_t parsed = 0;
+  double number = 0;
+  bool   value_ok = true;
+
+  // Only decimal numbers: std::stod also takes hexadecimal ones, infinities and NaN
+  if(value.find_first_not_of("0123456789+-.eE") != std::string::npos) value_ok = false;
+
+  try{
+    if(value_ok) number = std::stod(value, &parsed);
+  }
+  catch(const std::exception&){
+    parsed = 0;
+  }
+
+  // Infinities and NaN would pass (or skip) the range checks
+  if(!value_ok or parsed == 0 or parsed != value.size() or !std::isfinite(number)){
+    std::cerr << flag << " expects a number, not \"" << value << "\"" << std::endl;
+    std::cerr << helper_string << std::endl;
+    exit(1);
+  }
+
+  return number;
+}
+
+/** parse_unsigned
+    Parses the value of an integer argument, which must fit in 32 bits and
+    be at least `minimum`, exiting with the usage otherwise. Also used by the
+    tools for their own arguments
+
+    @param flag std::string name of the argument, for the error message
+    @param value std::string value given to the argument
+    @param helper_string std::string usage of the program
+    @param minimum uint32_t smallest value accepted
+    @return uint32_t parsed value
+
+*/
+uint32_t parse_unsigned(std::string flag, std::string value, std::string helper_string, uint32_t minimum){
+
+  double number = parse_number(flag, value, helper_string);
+
+  // The number is checked before any conversion, which is undefined out of range
+  if(number < minimum or number > UINT32_MAX or number != std::floor(number)){
+    std::cerr << flag << " expects an integer from " << minimum << " to " << UINT32_MAX << ", not \"" << value << "\"" << std::endl;
+    std::cerr << helper_string << std::endl;
+    exit(1);
+  }
+
+  return (uint32_t) number;
+}
 
 /** parse_gb_args
     Given the argv of the program, parses the input and provide the corrent arguments
     to the main function, in order to properly create the gameboy class. The available
     arguments are:
 
-     --rom path   -> path to the rom to run
-    [--fixed_fps] -> Fixes the fps to 60 while running the gameboy
-    [--help]      -> Prints the help message
+     --rom path       -> path to the rom to run
+    [--fixed_fps]     -> Runs the gameboy at real time (~59.7 fps), with audio
+    [--speed X]       -> Runs at X times real time, without audio (implies --fixed_fps)
+    [--headless]      -> Runs without window, keyboard and audio device
+    [--frames N]      -> Stops the emulator after N frames
+    [--capture path]  -> Records every frame in a lossless capture file. No frame
+                         is dropped: the emulation waits when the encoder is late
+    [--audio_out path]   -> Records the audio output in a WAV file
+    [--audio_stems]      -> With --audio_out, also records each channel in its own WAV file
+    [--input path]    -> Scripted input, used in headless mode
+    [--hash_record path] -> Writes the hashes of every frame in a file
+    [--hash_check path]  -> Compares the hashes of every frame with a file
+    [--no_save]       -> Never writes the save file of the cartridge
+    [--mmap_save]     -> Maps the save file in memory as the cartridge RAM
+    [--sample_rate N] -> Frequency of the audio output (48000 by default)
+    [--audio_latency ms] -> Audio buffered before the device (40 ms by default)
+    [--profile path]  -> Writes the time spent in each component (build with PROFILER)
+    [--perf path]     -> Writes the hardware counters of each frame (Linux)
+    [--stats_socket path] -> Serves live statistics on a Unix domain socket
+    [--help]          -> Prints the help message
 
     @param argc int Number of arguments in the cli command
     @param argv char*[] Array with the cli strings
@@ -19,8 +99,27 @@ gb_cli_args_t parse_gb_args(int argc, char* argv[]){
 
   gb_cli_args_t args;
   args.fixed_fps = 0;
+  args.headless = 0;
+  args.max_frames = 0;
   args.rom_file_name = "";
-  const std::string helper_string = "Usage: ./gameboy --rom path/to/rom [--fixed_fps]";
+  args.capture_file_name = "";
+  args.audio_file_name = "";
+  args.audio_stems = false;
+  args.input_file_name = "";
+  args.hash_file_name = "";
+  args.hash_record = false;
+  args.no_save = false;
+  args.mmap_save = false;
+  args.sample_rate = GB_DEFAULT_SAMPLE_RATE;
+  args.audio_latency = GB_DEFAULT_AUDIO_LATENCY;
+  args.speed = 1;
+  args.profile_file_name = "";
+  args.perf_file_name = "";
+  args.stats_socket_name = "";
+  const std::string helper_string = "Usage: ./gameboy --rom path/to/rom [--fixed_fps] [--speed X] [--headless] [--frames N] [--capture path]"
+                                    " [--audio_out path [--audio_stems]]"
+                                    " [--input path] [--hash_record path | --hash_check path] [--no_save] [--mmap_save]"
+                                    " [--sample_rate N] [--audio_latency ms] [--profile path] [--perf path] [--stats_socket path]";
 
   // Skip ./gameboy command
   for(int i = 1; i < argc; i++){
@@ -45,6 +144,105 @@ gb_cli_args_t parse_gb_args(int argc, char* argv[]){
     if(current_argv == "--fixed_fps"){
       args.fixed_fps = true;
     }
+
+    // if "--speed", consider next token if available
+    if(current_argv == "--speed"){
+      if(++i == argc) break;
+      args.speed = parse_number(current_argv, argv[i], helper_string);
+      args.fixed_fps = true;
+      continue;
+    }
+
+    // if "--headless", set the value to true
+    if(current_argv == "--headless"){
+      args.headless = true;
+    }
+
+    // if "--frames", consider next token if available
+    if(current_argv == "--frames"){
+      if(++i == argc) break;
+      args.max_frames = parse_unsigned(current_argv, argv[i], helper_string, 0);
+      continue;
+    }
+
+    // if "--capture", consider next token if available
+    if(current_argv == "--capture"){
+      if(++i == argc) break;
+      args.capture_file_name = argv[i];
+      continue;
+    }
+
+    // if "--audio_out", consider next token if available
+    if(current_argv == "--audio_out"){
+      if(++i == argc) break;
+      args.audio_file_name = argv[i];
+      continue;
+    }
+
+    // if "--audio_stems", set the value to true
+    if(current_argv == "--audio_stems"){
+      args.audio_stems = true;
+    }
+
+    // if "--input", consider next token if available
+    if(current_argv == "--input"){
+      if(++i == argc) break;
+      args.input_file_name = argv[i];
+      continue;
+    }
+
+    // if "--hash_record" or "--hash_check", consider next token if available
+    if(current_argv == "--hash_record" or current_argv == "--hash_check"){
+      if(++i == argc) break;
+      args.hash_file_name = argv[i];
+      args.hash_record = current_argv == "--hash_record";
+      continue;
+    }
+
+    // if "--no_save", set the value to true
+    if(current_argv == "--no_save"){
+      args.no_save = true;
+    }
+
+    // if "--mmap_save", set the value to true
+    if(current_argv == "--mmap_save"){
+      args.mmap_save = true;
+    }
+
+    // if "--sample_rate", consider next token if available
+    if(current_argv == "--sample_rate"){
+      if(++i == argc) break;
+      args.sample_rate = parse_unsigned(current_argv, argv[i], helper_string, 0);
+      continue;
+    }
+
+    // if "--audio_latency", consider next token if available
+    if(current_argv == "--audio_latency"){
+      if(++i == argc) break;
+      args.audio_latency = parse_unsigned(current_argv, argv[i], helper_string, 0);
+      continue;
+    }
+
+    // if "--profile", consider next token if available
+    if(current_argv == "--profile"){
+      if(++i == argc) break;
+      args.profile_file_name = argv[i];
+      continue;
+    }
+
+    // if "--perf", consider next token if available
+    if(current_argv == "--perf"){
+      if(++i == argc) break;
+      args.perf_file_name = argv[i];
+      continue;
+    }
+
+    // if "--stats_socket", consider next token if available
+    if(current_argv == "--stats_socket"){
+      if(++i == argc) break;
+      args.stats_socket_name = argv[i];
+      continue;
+    }
   }
 
   if(args.rom_file_name == ""){
@@ -52,5 +250,41 @@ gb_cli_args_t parse_gb_args(int argc, char* argv[]){
     exit(1);
   }
 
+  if(args.speed < GB_MIN_SPEED or args.speed > GB_MAX_SPEED){
+    std::cerr << "--speed must be in the range [" << GB_MIN_SPEED << ", " << GB_MAX_SPEED << "]" << std::endl;
+    exit(1);
+  }
+
+  // The output is band-limited from the APU frequency, which must be higher than the sample rate
+  if(args.sample_rate < GB_MIN_SAMPLE_RATE or args.sample_rate > GB_MAX_SAMPLE_RATE){
+    std::cerr << "--sample_rate must be in the range [" << GB_MIN_SAMPLE_RATE << ", " << GB_MAX_SAMPLE_RATE << "]" << std::endl;
+    exit(1);
+  }
+
+  if(args.audio_latency < GB_MIN_AUDIO_LATENCY or args.audio_latency > GB_MAX_AUDIO_LATENCY){
+    std::cerr << "--audio_latency must be in the range [" << GB_MIN_AUDIO_LATENCY << ", " << GB_MAX_AUDIO_LATENCY << "]" << std::endl;
+    exit(1);
+  }
+
+  // Stems are written next to the main audio file
+  if(args.audio_stems and args.audio_file_name == ""){
+    std::cerr << "--audio_stems is ignored without --audio_out" << std::endl;
+    args.audio_stems = false;
+  }
+
+  // Keyboard input is used whenever a window is available
+  if(!args.headless and args.input_file_name != ""){
+    std::cerr << "--input is ignored without --headless" << std::endl;
+    args.input_file_name = "";
+  }
+
+  // The instrumentation of the bus has no cost if not compiled
+  #ifndef __PROFILER
+  if(args.profile_file_name != ""){
+    std::cerr << "--profile is ignored without the PROFILER build option" << std::endl;
+    args.profile_file_name = "";
+  }
+  #endif
+
   return args;
 }
@@ -3,12 +3,41 @@
 
 #include <string>
 #include <iostream>
+#include <cstdint>
+
+#define GB_DEFAULT_SAMPLE_RATE 48000
+#define GB_MIN_SAMPLE_RATE     8000
+#define GB_MAX_SAMPLE_RATE     192000
+
+#define GB_MIN_SPEED 0.1
+#define GB_MAX_SPEED 16
+
+#define GB_DEFAULT_AUDIO_LATENCY 40
+#define GB_MIN_AUDIO_LATENCY     10
+#define GB_MAX_AUDIO_LATENCY     500
 
 struct gb_cli_args_t {
   std::string rom_file_name;
   bool        fixed_fps;
+  bool        headless;
+  uint32_t    max_frames;
+  std::string capture_file_name;
+  std::string audio_file_name;
+  bool        audio_stems;
+  std::string input_file_name;
+  std::string hash_file_name;
+  bool        hash_record;
+  bool        no_save;
+  bool        mmap_save;
+  uint32_t    sample_rate;
+  uint32_t    audio_latency;
+  float       speed;
+  std::string profile_file_name;
+  std::string perf_file_name;
+  std::string stats_socket_name;
 };
 
 gb_cli_args_t parse_gb_args(int, char*[]);
+uint32_t      parse_unsigned(std::string, std::string, std::string, uint32_t);
 
 #endif // __CLI_PARSER_H
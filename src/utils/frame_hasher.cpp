@@ -0,0 +1,137 @@
+#include "frame_hasher.h"
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+
+/** to_hex
+    Formats a hash as 16 hexadecimal digits
+
+    @param value uint64_t hash
+    @return std::string formatted hash
+
+*/
+static std::string to_hex(uint64_t value){
+  std::ostringstream stream;
+  stream << std::hex << std::setw(16) << std::setfill('0') << value;
+  return stream.str();
+}
+
+/** Frame_hasher::Frame_hasher
+    Constructor of the class. In record mode the file is created, in check mode
+    the baseline is loaded
+
+    @param file_name std::string path to the hash file
+    @param record bool true to record the hashes, false to check them
+
+*/
+Frame_hasher::Frame_hasher(std::string file_name, bool record){
+
+  _record = record;
+  _next_baseline = 0;
+  _diverged = false;
+  _diverging_frame = 0;
+
+  if(_record){
+    _output.open(file_name);
+    if(!_output.is_open())
+      throw std::invalid_argument("Unable to create hash file " + file_name);
+    _output << FRAME_HASHER_HEADER << "\n";
+    return;
+  }
+
+  std::ifstream input_file(file_name);
+  if(!input_file.is_open())
+    throw std::invalid_argument("Unable to open hash file " + file_name);
+
+  std::string line;
+  if(!std::getline(input_file, line) or line != FRAME_HASHER_HEADER)
+    throw std::invalid_argument("Wrong header in hash file " + file_name);
+
+  while(std::getline(input_file, line)){
+    if(line.empty()) continue;
+    std::istringstream tokens(line);
+    Frame_hashes hashes;
+    if(!(tokens >> std::dec >> hashes.frame >> std::hex >> hashes.frame_hash >> hashes.state_hash))
+      throw std::invalid_argument("Malformed line in hash file " + file_name);
+    _baseline.push_back(hashes);
+  }
+}
+
+/** Frame_hasher::push_frame
+    Records or checks the hashes of a frame
+
+    @param frame uint32_t index of the frame
+    @param frame_hash uint64_t hash of the display
+    @param state_hash uint64_t hash of the memories
+
+*/
+void Frame_hasher::push_frame(uint32_t frame, uint64_t frame_hash, uint64_t state_hash){
+
+  if(_record){
+    _output << frame << " " << to_hex(frame_hash) << " " << to_hex(state_hash) << "\n";
+    return;
+  }
+
+  // Only the first divergence is interesting, the following ones are a consequence
+  if(_diverged) return;
+
+  if(_next_baseline == _baseline.size()){
+    _diverged = true;
+    _diverging_frame = frame;
+    _divergence = "frame not in baseline";
+    return;
+  }
+
+  const Frame_hashes& expected = _baseline[_next_baseline++];
+
+  if(expected.frame != frame){
+    _divergence = "frame index " + std::to_string(expected.frame) + " expected";
+  } else if(expected.frame_hash != frame_hash){
+    _divergence = "frame hash " + to_hex(frame_hash) + " instead of " + to_hex(expected.frame_hash);
+  } else if(expected.state_hash != state_hash){
+    _divergence = "state hash " + to_hex(state_hash) + " instead of " + to_hex(expected.state_hash);
+  } else {
+    return;
+  }
+
+  _diverged = true;
+  _diverging_frame = frame;
+}
+
+/** Frame_hasher::finish
+    Called at the end of the run: in check mode, the run diverges if
+    it did not reach all the frames of the baseline
+
+*/
+void Frame_hasher::finish(){
+
+  if(_record or _diverged or _next_baseline == _baseline.size()) return;
+
+  _diverged = true;
+  _diverging_frame = _baseline[_next_baseline].frame;
+  _divergence = "baseline frame " + std::to_string(_diverging_frame) + " not reached";
+}
+
+/** Frame_hasher::has_diverged
+    @return bool true if a frame did not match the baseline
+
+*/
+bool Frame_hasher::has_diverged(){
+  return _diverged;
+}
+
+/** Frame_hasher::get_diverging_frame
+    @return uint32_t first frame which did not match the baseline
+
+*/
+uint32_t Frame_hasher::get_diverging_frame(){
+  return _diverging_frame;
+}
+
+/** Frame_hasher::get_divergence
+    @return std::string description of the first divergence
+
+*/
+std::string Frame_hasher::get_divergence(){
+  return _divergence;
+}
@@ -0,0 +1,53 @@
+#ifndef __FRAME_HASHER_H
+#define __FRAME_HASHER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+
+/*
+ * Hash file format, one text line per frame after the header:
+ *
+ *    # gameboy frame hashes v1
+ *    <frame> <frame hash> <state hash>
+ *
+ * Hashes are 16 hexadecimal digits. The frame hash covers the display
+ * matrix, the state hash covers the memories of the gameboy.
+ *
+ * In record mode the hashes are written to the file; in check mode they
+ * are compared with the ones stored in the file and the first diverging
+ * frame is kept. A run which ends before the last frame of the baseline
+ * diverges as well, once it is finished.
+ * */
+#define FRAME_HASHER_HEADER "# gameboy frame hashes v1"
+
+class Frame_hasher {
+
+  struct Frame_hashes {
+    uint32_t frame;
+    uint64_t frame_hash;
+    uint64_t state_hash;
+  };
+
+  bool                      _record;
+  std::ofstream             _output;
+  std::vector<Frame_hashes> _baseline;
+  size_t                    _next_baseline;
+
+  // First divergence found in check mode
+  bool                      _diverged;
+  uint32_t                  _diverging_frame;
+  std::string               _divergence;
+
+public:
+
+  Frame_hasher(std::string, bool);
+  void        push_frame(uint32_t, uint64_t, uint64_t);
+  void        finish();
+  bool        has_diverged();
+  uint32_t    get_diverging_frame();
+  std::string get_divergence();
+};
+
+#endif // __FRAME_HASHER_H
@@ -0,0 +1,112 @@
+#include "frame_timer.h"
+#include <iostream>
+
+/** Frame_timer::Frame_timer
+    Constructor of the class
+
+    @param frequency uint32_t emulated cycles per second of real time
+    @param speed double speed multiplier of the pacing
+    @param paced bool whether the emulation is kept at real time
+
+*/
+Frame_timer::Frame_timer(uint32_t frequency, double speed, bool paced){
+
+  _pacer = paced ? new Pacer(frequency, speed) : nullptr;
+  _frequency = frequency;
+  _cycles = 0;
+  _frame_cycles = 0;
+  _frame_start = clock::now();
+  _frame_ns = 0;
+  _frames = 0;
+  _window_cycles = 0;
+  _window_start = _frame_start;
+  _fps = 0;
+  _speed = 0;
+}
+
+/** Frame_timer::advance
+    Account for some emulated cycles, waiting if the emulation is ahead of time
+
+    @param cycles uint32_t number of cycles emulated since the last call
+
+*/
+void Frame_timer::advance(uint32_t cycles){
+
+  _cycles += cycles;
+  if(_pacer) _pacer->advance(cycles);
+}
+
+/** Frame_timer::end_frame
+    A frame was completed. This is the only place where the host clock is
+    sampled for statistics: the duration of the frame (pacing included) is
+    measured, and the FPS and the speed at the end of each window
+
+*/
+void Frame_timer::end_frame(){
+
+  clock::time_point now = clock::now();
+
+  _frame_cycles = _cycles;
+  _cycles = 0;
+  _frame_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - _frame_start).count();
+  _frame_start = now;
+  _frames++;
+  _window_cycles += _frame_cycles;
+
+  std::chrono::duration<double> elapsed = now - _window_start;
+  if(elapsed < std::chrono::milliseconds(FRAME_TIMER_WINDOW_MS)) return;
+
+  _fps = _frames / elapsed.count();
+  _speed = _window_cycles / (double) _frequency / elapsed.count();
+  _frames = 0;
+  _window_cycles = 0;
+  _window_start = now;
+
+  #ifdef __DEBUG
+  std::cout << "[FPS: " << _fps << "\t]\n";
+  #endif
+}
+
+/** Frame_timer::get_fps
+    @return double frames per second in the last complete window, 0 before
+
+*/
+double Frame_timer::get_fps(){
+  return _fps;
+}
+
+/** Frame_timer::get_speed
+    @return double emulated time over real time in the last complete window,
+                   the emulated time being the cycles over the frequency given
+                   to the timer (GAMEBOY_PACING_FREQUENCY, the real-time pacing of
+                   the emulator, not the clock of the Game Boy): 1 at --speed 1,
+                   0 before
+
+*/
+double Frame_timer::get_speed(){
+  return _speed;
+}
+
+/** Frame_timer::get_frame_time_ns
+    @return uint64_t wall time of the last complete frame, pacing included
+
+*/
+uint64_t Frame_timer::get_frame_time_ns(){
+  return _frame_ns;
+}
+
+/** Frame_timer::get_frame_cycles
+    @return uint64_t emulated cycles of the last complete frame
+
+*/
+uint64_t Frame_timer::get_frame_cycles(){
+  return _frame_cycles;
+}
+
+/** Frame_timer::~Frame_timer
+    Destroy the timer
+
+*/
+Frame_timer::~Frame_timer(){
+  delete _pacer;
+}
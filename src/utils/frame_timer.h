@@ -0,0 +1,53 @@
+#ifndef __FRAME_TIMER_H
+#define __FRAME_TIMER_H
+
+#include <cstdint>
+#include <chrono>
+#include "pacer.h"
+
+// Duration of the window on which the FPS are measured
+#define FRAME_TIMER_WINDOW_MS 1000
+
+/*
+ * Single owner of the wall-clock timing of the emulation. The gameboy
+ * reports the emulated cycles in chunks and the end of each frame: the
+ * chunks feed the pacer (if any), while the host clock is sampled once
+ * per frame to measure the duration of the frame, and the FPS and the
+ * speed over windows of FRAME_TIMER_WINDOW_MS.
+ * */
+class Frame_timer {
+
+  typedef std::chrono::steady_clock clock;
+
+  // Optional pacing at real time
+  Pacer*            _pacer;
+  uint32_t          _frequency;
+
+  // Emulated cycles of the current frame and of the last complete one
+  uint64_t          _cycles;
+  uint64_t          _frame_cycles;
+
+  // Wall time of the last complete frame
+  clock::time_point _frame_start;
+  uint64_t          _frame_ns;
+
+  // Frames and cycles completed in the current window
+  uint32_t          _frames;
+  uint64_t          _window_cycles;
+  clock::time_point _window_start;
+  double            _fps;
+  double            _speed;
+
+public:
+
+  Frame_timer(uint32_t, double, bool);
+  void     advance(uint32_t);
+  void     end_frame();
+  double   get_fps();
+  double   get_speed();
+  uint64_t get_frame_cycles();
+  uint64_t get_frame_time_ns();
+  ~Frame_timer();
+};
+
+#endif // __FRAME_TIMER_H
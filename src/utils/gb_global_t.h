@@ -24,8 +24,24 @@ struct gb_global_t{
   // Double_speed mode of the system
   uint8_t double_speed;
 
-  // Whether the fps should be fixed or not
+  // Whether the emulation is paced at real time or not
   uint8_t fixed_fps;
+
+  // Speed multiplier of the pacing; audio is muted when it is not 1
+  float speed;
+
+  // Whether the emulator runs without window, keyboard and audio device
+  uint8_t headless;
+
+  // Frequency requested to the audio device, in samples per second
+  uint32_t sample_rate;
+
+  // Audio buffered between the emulation and the audio device, in milliseconds
+  uint32_t audio_latency;
+
+  // Set by the PPU when a frame is completed, cleared by the gameboy
+  // once the end-of-frame operations have been performed
+  uint8_t frame_ready;
 };
 
 #endif // __GB_GLOBAL_T_H
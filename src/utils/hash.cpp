@@ -0,0 +1,67 @@
+#include "hash.h"
+#include <cstring>
+
+#define GB_HASH_PRIME_1 0x9E3779B185EBCA87ULL
+#define GB_HASH_PRIME_2 0xC2B2AE3D27D4EB4FULL
+#define GB_HASH_PRIME_3 0x165667B19E3779F9ULL
+#define GB_HASH_PRIME_4 0x85EBCA77C2B2AE63ULL
+#define GB_HASH_PRIME_5 0x27D4EB2F165667C5ULL
+
+/** rotl
+    Rotate a 64-bit value to the left
+
+    @param value uint64_t value to rotate
+    @param amount int number of positions
+    @return uint64_t rotated value
+
+*/
+static inline uint64_t rotl(uint64_t value, int amount){
+  return (value << amount) | (value >> (64 - amount));
+}
+
+/** gb_hash64
+    Fast non-cryptographic 64-bit hash (same mixing steps as xxHash64, one lane).
+    It is used to compare frames and memory states across runs, so it only needs
+    to be deterministic and well distributed.
+
+    @param data const void* data to hash
+    @param size size_t number of bytes
+    @param seed uint64_t initial value, used to chain several buffers
+    @return uint64_t hash of the data
+
+*/
+uint64_t gb_hash64(const void* data, size_t size, uint64_t seed){
+
+  const uint8_t* bytes = (const uint8_t*)data;
+  uint64_t hash = seed + GB_HASH_PRIME_5 + size;
+  uint64_t word;
+
+  // Process 8 bytes at a time
+  while(size >= 8){
+    memcpy(&word, bytes, 8);
+    word *= GB_HASH_PRIME_2;
+    word  = rotl(word, 31);
+    word *= GB_HASH_PRIME_1;
+    hash ^= word;
+    hash  = rotl(hash, 27) * GB_HASH_PRIME_1 + GB_HASH_PRIME_4;
+    bytes += 8;
+    size  -= 8;
+  }
+
+  // Remaining bytes
+  while(size > 0){
+    hash ^= (*bytes) * GB_HASH_PRIME_5;
+    hash  = rotl(hash, 11) * GB_HASH_PRIME_1;
+    bytes++;
+    size--;
+  }
+
+  // Final avalanche
+  hash ^= hash >> 33;
+  hash *= GB_HASH_PRIME_2;
+  hash ^= hash >> 29;
+  hash *= GB_HASH_PRIME_3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
@@ -0,0 +1,11 @@
+#ifndef __HASH_H
+#define __HASH_H
+
+#include <cstdint>
+#include <cstddef>
+
+#define GB_HASH_SEED 0x9E3779B97F4A7C15ULL
+
+uint64_t gb_hash64(const void*, size_t, uint64_t = GB_HASH_SEED);
+
+#endif // __HASH_H
@@ -0,0 +1,85 @@
+#include "input_script.h"
+#include "../IO/joypad.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+/** Input_script::Input_script
+    Constructor of the class, it parses the whole script
+
+    @param file_name std::string path to the script
+
+*/
+Input_script::Input_script(std::string file_name){
+
+  std::ifstream input_file(file_name);
+  if(!input_file.is_open())
+    throw std::invalid_argument("Unable to open input script " + file_name);
+
+  std::string line;
+  uint32_t line_number = 0;
+
+  while(std::getline(input_file, line)){
+    line_number++;
+    if(line.empty() or line[0] == '#') continue;
+
+    std::istringstream tokens(line);
+    uint32_t frame;
+    std::string buttons;
+    if(!(tokens >> frame >> buttons))
+      throw std::invalid_argument("Malformed line " + std::to_string(line_number) + " in input script");
+
+    _events[frame] = parse_buttons(buttons, line_number);
+  }
+}
+
+/** Input_script::parse_buttons
+    Converts a comma separated list of buttons into the scancodes used by the joypad
+
+    @param buttons const std::string& list of buttons
+    @param line_number uint32_t line of the script, used for errors
+    @return std::vector<uint8_t> scancodes of the buttons
+
+*/
+std::vector<uint8_t> Input_script::parse_buttons(const std::string& buttons, uint32_t line_number){
+
+  static const std::map<std::string, uint8_t> button_codes = {
+    {"A",       JOYPAD_A_BUTTON},
+    {"B",       JOYPAD_B_BUTTON},
+    {"START",   JOYPAD_START_BUTTON},
+    {"SELECT",  JOYPAD_SELECT_BUTTON},
+    {"UP",      JOYPAD_UP_BUTTON},
+    {"DOWN",    JOYPAD_DOWN_BUTTON},
+    {"LEFT",    JOYPAD_LEFT_BUTTON},
+    {"RIGHT",   JOYPAD_RIGHT_BUTTON},
+  };
+
+  std::vector<uint8_t> keys;
+  std::istringstream names(buttons);
+  std::string name;
+
+  while(std::getline(names, name, ',')){
+    if(name == "NONE") continue;
+    auto code = button_codes.find(name);
+    if(code == button_codes.end())
+      throw std::invalid_argument("Unknown button " + name + " at line " + std::to_string(line_number) + " in input script");
+    keys.push_back(code->second);
+  }
+
+  return keys;
+}
+
+/** Input_script::get_keys
+    Provides the keys to hold if they change at the given frame
+
+    @param frame uint32_t current frame
+    @param keys std::vector<uint8_t>& destination of the scancodes
+    @return bool true if the held keys change at this frame
+
+*/
+bool Input_script::get_keys(uint32_t frame, std::vector<uint8_t>& keys){
+  auto event = _events.find(frame);
+  if(event == _events.end()) return false;
+  keys = event->second;
+  return true;
+}
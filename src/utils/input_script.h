@@ -0,0 +1,32 @@
+#ifndef __INPUT_SCRIPT_H
+#define __INPUT_SCRIPT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+
+/*
+ * Input script used in headless mode. Each non-empty line which does not
+ * start with '#' has the format
+ *
+ *    <frame> <BUTTON>[,<BUTTON>...]
+ *
+ * where BUTTON is one among A, B, START, SELECT, UP, DOWN, LEFT, RIGHT, or
+ * NONE to release everything. Starting from <frame>, the listed buttons are
+ * held until the next line of the script.
+ * */
+class Input_script {
+
+  // Scancodes held starting from a given frame
+  std::map<uint32_t, std::vector<uint8_t>> _events;
+
+  std::vector<uint8_t> parse_buttons(const std::string&, uint32_t);
+
+public:
+
+  Input_script(std::string);
+  bool get_keys(uint32_t, std::vector<uint8_t>&);
+};
+
+#endif // __INPUT_SCRIPT_H
@@ -0,0 +1,51 @@
+#include "pacer.h"
+#include <thread>
+#include <stdexcept>
+
+/** Pacer::Pacer
+    Constructor of the class
+
+    @param frequency uint32_t cycles of the emulated clock per second
+    @param speed double speed multiplier (1 for real time)
+
+*/
+Pacer::Pacer(uint32_t frequency, double speed){
+
+  if(frequency == 0 or speed <= 0) throw std::invalid_argument("Pacer: frequency and speed must be positive");
+
+  _frequency = frequency;
+  _speed = speed;
+  reset();
+}
+
+/** Pacer::reset
+    The current instant becomes the reference of the emulated time
+
+*/
+void Pacer::reset(){
+  _reference = clock::now();
+  _cycles = 0;
+}
+
+/** Pacer::advance
+    Account for some emulated cycles, and wait until they are due in real time
+
+    @param cycles uint32_t number of cycles emulated since the last call
+
+*/
+void Pacer::advance(uint32_t cycles){
+
+  _cycles += cycles;
+
+  std::chrono::nanoseconds emulated((int64_t)(_cycles * 1e9 / (_frequency * _speed)));
+  clock::time_point deadline = _reference + emulated;
+  clock::time_point now = clock::now();
+
+  // Too late: forget about the lost time
+  if(now > deadline + std::chrono::milliseconds(PACER_MAX_LAG_MS)){
+    reset();
+    return;
+  }
+
+  if(now < deadline) std::this_thread::sleep_until(deadline);
+}
@@ -0,0 +1,36 @@
+#ifndef __PACER_H
+#define __PACER_H
+
+#include <cstdint>
+#include <chrono>
+
+// When the emulation is late of more than this, the lost time is not recovered
+#define PACER_MAX_LAG_MS 100
+
+/*
+ * Keeps the emulation at real time (or at a multiple of it), independently
+ * from the audio. The emulated time is measured in clock cycles; after each
+ * chunk of emulation, the pacer sleeps until the monotonic clock reaches the
+ * time at which the chunk should end. If the host cannot keep up, the
+ * reference is moved forward instead of running faster to recover.
+ * */
+class Pacer {
+
+  typedef std::chrono::steady_clock clock;
+
+  // Frequency of the emulated clock and speed multiplier
+  uint32_t          _frequency;
+  double            _speed;
+
+  // Real time corresponding to the emulated cycle 0
+  clock::time_point _reference;
+  uint64_t          _cycles;
+
+public:
+
+  Pacer(uint32_t, double);
+  void advance(uint32_t);
+  void reset();
+};
+
+#endif // __PACER_H
@@ -0,0 +1,203 @@
+#include "perf_counters.h"
+#include <iostream>
+#include <stdexcept>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+/** Perf_counters::Perf_counters
+    Constructor of the class. The file is only created if at least one
+    counter is available
+
+    @param file_name std::string path of the JSON file with the counters of each frame
+
+*/
+Perf_counters::Perf_counters(std::string file_name){
+
+  _leader = -1;
+  _opened = 0;
+  _frames = 0;
+  for(int i = 0; i < PERF_COUNTERS; i++){
+    _fds[i] = -1;
+    _slots[i] = -1;
+  }
+
+  open_counters();
+  if(_opened == 0) return;
+
+  for(int i = 0; i < PERF_COUNTERS; i++){
+    if(!has_counter(i)) std::cerr << "Hardware counter " << get_name(i) << " not available" << std::endl;
+  }
+
+  _file.open(file_name);
+  if(!_file.is_open())
+    throw std::invalid_argument("Perf file " + file_name + " not opened correctly.");
+
+  _file << "{\n  \"counters\": [\"frame\"";
+  for(int i = 0; i < PERF_COUNTERS; i++) if(has_counter(i)) _file << ", \"" << get_name(i) << "\"";
+  _file << "],\n  \"frames\": [";
+
+  read(_last);
+}
+
+/** Perf_counters::open_counters
+    Open the available counters in a single group, which starts counting
+    once all of them are opened
+
+*/
+void Perf_counters::open_counters(){
+
+  #ifdef __linux__
+  const uint32_t types[PERF_COUNTERS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE
+  };
+  const uint64_t configs[PERF_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+    PERF_COUNT_HW_CACHE_MISSES
+  };
+
+  for(int i = 0; i < PERF_COUNTERS; i++){
+
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = _leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    int fd = syscall(SYS_perf_event_open, &attr, 0, -1, _leader, 0);
+    if(fd < 0) continue;
+
+    if(_leader < 0) _leader = fd;
+    _fds[i] = fd;
+    _slots[i] = _opened++;
+  }
+
+  if(_leader < 0){
+    std::cerr << "Hardware counters not available (check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+    return;
+  }
+
+  ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  #else
+  std::cerr << "Hardware counters are only available on Linux" << std::endl;
+  #endif
+}
+
+/** Perf_counters::is_available
+    @return bool whether at least one counter is available
+
+*/
+bool Perf_counters::is_available(){
+  return _opened != 0;
+}
+
+/** Perf_counters::has_counter
+    @param counter uint32_t index of the counter
+    @return bool whether the counter is available
+
+*/
+bool Perf_counters::has_counter(uint32_t counter){
+  return _slots[counter] >= 0;
+}
+
+/** Perf_counters::get_name
+    @param counter uint32_t index of the counter
+    @return const char* name of the counter
+
+*/
+const char* Perf_counters::get_name(uint32_t counter){
+  static const char* names[PERF_COUNTERS] = PERF_COUNTER_NAMES;
+  return names[counter];
+}
+
+/** Perf_counters::read
+    Read all the counters at once, without scaling them
+
+    @param sample Perf_sample& raw values since the opening, 0 for the
+                               counters not available
+
+*/
+void Perf_counters::read(Perf_sample& sample){
+
+  // Number of counters, time enabled, time running, then the values
+  uint64_t data[3 + PERF_COUNTERS];
+
+  sample.enabled_ns = 0;
+  sample.running_ns = 0;
+  for(int i = 0; i < PERF_COUNTERS; i++) sample.values[i] = 0;
+  if(_leader < 0 or ::read(_leader, data, sizeof(data)) < (ssize_t) (3 * sizeof(uint64_t))) return;
+
+  sample.enabled_ns = data[1];
+  sample.running_ns = data[2];
+  for(int i = 0; i < PERF_COUNTERS; i++){
+    if(_slots[i] >= 0 and (uint64_t) _slots[i] < data[0]) sample.values[i] = data[3 + _slots[i]];
+  }
+}
+
+/** Perf_counters::get_delta
+    Counts between two samples. If the kernel had to share the hardware
+    among more counters in the interval, the counts are scaled to its whole
+    duration with the ratio of that interval only
+
+    @param from const Perf_sample& sample at the beginning of the interval
+    @param to const Perf_sample& sample at the end of the interval
+    @param deltas uint64_t* PERF_COUNTERS counts in the interval
+
+*/
+void Perf_counters::get_delta(const Perf_sample& from, const Perf_sample& to, uint64_t* deltas){
+
+  uint64_t enabled = to.enabled_ns - from.enabled_ns;
+  uint64_t running = to.running_ns - from.running_ns;
+  double   scale = (running != 0 and running < enabled) ? (double) enabled / running : 1;
+
+  for(int i = 0; i < PERF_COUNTERS; i++) deltas[i] = (to.values[i] - from.values[i]) * scale;
+}
+
+/** Perf_counters::end_frame
+    Write the counters of the frame just completed
+
+*/
+void Perf_counters::end_frame(){
+
+  if(_opened == 0) return;
+
+  Perf_sample sample;
+  uint64_t    deltas[PERF_COUNTERS];
+  read(sample);
+  get_delta(_last, sample, deltas);
+  _last = sample;
+
+  _file << (_frames ? ",\n" : "\n") << "    [" << _frames;
+  for(int i = 0; i < PERF_COUNTERS; i++){
+    if(has_counter(i)) _file << ", " << deltas[i];
+  }
+  _file << "]";
+
+  _frames++;
+}
+
+/** Perf_counters::~Perf_counters
+    The file is completed and the counters are closed
+
+*/
+Perf_counters::~Perf_counters(){
+
+  if(_file.is_open()) _file << "\n  ]\n}\n";
+
+  for(int i = 0; i < PERF_COUNTERS; i++){
+    if(_fds[i] >= 0) close(_fds[i]);
+  }
+}
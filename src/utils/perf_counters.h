@@ -0,0 +1,63 @@
+#ifndef __PERF_COUNTERS_H
+#define __PERF_COUNTERS_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+// Hardware counters measured, in the order of PERF_COUNTER_NAMES
+#define PERF_COUNTERS 5
+#define PERF_COUNTER_NAMES {"cycles", "instructions", "branch_misses", "l1d_read_misses", "llc_misses"}
+
+// Raw values of the counters at a given time, with the time during which the
+// group was enabled and the time during which it was actually counting
+struct Perf_sample {
+  uint64_t enabled_ns;
+  uint64_t running_ns;
+  uint64_t values[PERF_COUNTERS];
+};
+
+/*
+ * Hardware performance counters of the emulation thread (Linux perf_event_open),
+ * counting only in user space. The counters are opened as a group, so that
+ * they are read together with a single system call; those not supported by
+ * the CPU, the kernel or the permissions (perf_event_paranoid) are skipped,
+ * and if none is available the counters are not used at all.
+ *
+ * When the kernel shares the hardware among more counters, the group only
+ * counts for part of the time. The raw values are kept, and each interval is
+ * scaled by its own ratio of enabled to running time: scaling the cumulative
+ * values would make the differences wrong, or even negative, whenever the
+ * ratio changes.
+ *
+ * The counters are written for each frame in a JSON file, and they can be
+ * read by the profiler to attribute them to each component.
+ * */
+class Perf_counters {
+
+  int           _fds[PERF_COUNTERS];
+  int           _leader;
+
+  // Position of each counter in the values read from the group
+  int           _slots[PERF_COUNTERS];
+  uint32_t      _opened;
+
+  std::ofstream _file;
+  Perf_sample   _last;
+  uint32_t      _frames;
+
+  void open_counters();
+
+public:
+
+  Perf_counters(std::string);
+  bool        is_available();
+  bool        has_counter(uint32_t);
+  static const char* get_name(uint32_t);
+  void        read(Perf_sample&);
+  void        get_delta(const Perf_sample&, const Perf_sample&, uint64_t*);
+  void        end_frame();
+  ~Perf_counters();
+};
+
+#endif // __PERF_COUNTERS_H
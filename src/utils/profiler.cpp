@@ -0,0 +1,251 @@
+#include "profiler.h"
+#include <stdexcept>
+
+/** Profiler::Profiler
+    Constructor of the class. The Chrome trace is written next to the JSON
+    file: out.json -> out_trace.json
+
+    @param file_name std::string path of the JSON file
+
+*/
+Profiler::Profiler(std::string file_name){
+
+  std::string trace_name = file_name;
+  size_t extension = trace_name.rfind(".json");
+  if(extension != std::string::npos and extension == trace_name.size() - 5) trace_name.resize(extension);
+  trace_name += "_trace.json";
+
+  _json_file.open(file_name);
+  if(!_json_file.is_open())
+    throw std::invalid_argument("Profile file " + file_name + " not opened correctly.");
+
+  _trace_file.open(trace_name);
+  if(!_trace_file.is_open())
+    throw std::invalid_argument("Profile file " + trace_name + " not opened correctly.");
+
+  _counters = nullptr;
+  _depth = 0;
+  _frames = 0;
+  _window_frames = 0;
+  _start = clock::now();
+  _window_start = _start;
+}
+
+/** Profiler::add_component
+    Add a component to profile, whose index is the order of the calls
+
+    @param name std::string name of the component
+
+*/
+void Profiler::add_component(std::string name){
+  _names.push_back(name);
+  _current.push_back(Component_stats());
+}
+
+/** Profiler::set_counters
+    Attribute also the hardware counters to the components
+
+    @param counters Perf_counters* counters to read, or nullptr
+
+*/
+void Profiler::set_counters(Perf_counters* counters){
+  if(counters != nullptr and !counters->is_available()) counters = nullptr;
+  _counters = counters;
+}
+
+/** Profiler::elapsed_ns
+    @param from clock::time_point initial time
+    @param to clock::time_point final time
+    @return uint64_t nanoseconds between the two times
+
+*/
+uint64_t Profiler::elapsed_ns(clock::time_point from, clock::time_point to){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+}
+
+/** Profiler::begin
+    Start measuring a component, possibly while another one is measured
+
+    @param component uint32_t index of the component
+
+*/
+void Profiler::begin(uint32_t component){
+
+  if(_depth == PROFILER_MAX_DEPTH) throw std::runtime_error("Profiler: too many nested measurements");
+
+  Measure& measure = _stack[_depth++];
+  measure.component = component;
+  measure.children_ns = 0;
+  if(_counters){
+    for(int i = 0; i < PERF_COUNTERS; i++) measure.children_counters[i] = 0;
+    _counters->read(measure.counters);
+  }
+  measure.start = clock::now();
+}
+
+/** Profiler::end
+    Stop measuring the last component. The time of the nested measurements
+    is not accounted to it, but it is to the component it is nested in
+
+    @param calls uint32_t number of steps (or runs) performed
+    @param cycles uint32_t number of cycles performed
+
+*/
+void Profiler::end(uint32_t calls, uint32_t cycles){
+
+  Measure& measure = _stack[--_depth];
+  uint64_t elapsed = elapsed_ns(measure.start, clock::now());
+  Component_stats& stats = _current[measure.component];
+
+  stats.calls   += calls;
+  stats.cycles  += cycles;
+  stats.time_ns += elapsed - measure.children_ns;
+
+  if(_depth != 0) _stack[_depth - 1].children_ns += elapsed;
+
+  if(_counters){
+    Perf_sample counters;
+    uint64_t    deltas[PERF_COUNTERS];
+    _counters->read(counters);
+    _counters->get_delta(measure.counters, counters, deltas);
+    for(int i = 0; i < PERF_COUNTERS; i++){
+      // The nested measurements are scaled with their own ratio, which may
+      // give them slightly more than the whole measurement
+      if(deltas[i] > measure.children_counters[i]) stats.counters[i] += deltas[i] - measure.children_counters[i];
+      if(_depth != 0) _stack[_depth - 1].children_counters[i] += deltas[i];
+    }
+  }
+}
+
+/** Profiler::end_frame
+    A frame was completed, and the window is closed once it contains
+    PROFILER_WINDOW_FRAMES frames
+
+*/
+void Profiler::end_frame(){
+  _frames++;
+  if(++_window_frames == PROFILER_WINDOW_FRAMES) close_window();
+}
+
+/** Profiler::close_window
+    Store the counters of the current window, and start a new one
+
+*/
+void Profiler::close_window(){
+
+  clock::time_point now = clock::now();
+
+  _windows.push_back({_frames - _window_frames, _window_frames,
+                      elapsed_ns(_start, _window_start), elapsed_ns(_window_start, now), _current});
+
+  for(auto& stats : _current) stats = Component_stats();
+  _window_frames = 0;
+  _window_start = now;
+}
+
+/** Profiler::write_json
+    Write the windows as a JSON object: the components, and for each window
+    the counters of each component
+
+*/
+void Profiler::write_json(){
+
+  _json_file << "{\n  \"window_frames\": " << PROFILER_WINDOW_FRAMES << ",\n  \"windows\": [";
+
+  for(size_t w = 0; w < _windows.size(); w++){
+    Window& window = _windows[w];
+
+    _json_file << (w ? ",\n" : "\n") << "    {\"first_frame\": " << window.first_frame
+               << ", \"frames\": " << window.frames
+               << ", \"start_ns\": " << window.start_ns
+               << ", \"duration_ns\": " << window.duration_ns
+               << ", \"components\": {";
+
+    for(size_t c = 0; c < _names.size(); c++){
+      Component_stats& stats = window.components[c];
+      _json_file << (c ? ",\n" : "\n") << "      \"" << _names[c] << "\": {"
+                 << "\"calls\": "    << stats.calls
+                 << ", \"cycles\": " << stats.cycles
+                 << ", \"time_ns\": " << stats.time_ns
+                 << ", \"reads\": "  << stats.reads
+                 << ", \"writes\": " << stats.writes;
+      write_counters(_json_file, stats);
+      _json_file << "}";
+    }
+
+    _json_file << "\n    }}";
+  }
+
+  _json_file << "\n  ]\n}\n";
+}
+
+/** Profiler::write_counters
+    Write the hardware counters of a component, if any, as a JSON member
+
+    @param file std::ofstream& file to write
+    @param stats Component_stats& counters of the component
+
+*/
+void Profiler::write_counters(std::ofstream& file, Component_stats& stats){
+
+  if(_counters == nullptr) return;
+
+  const char* separator = "";
+  file << ", \"counters\": {";
+  for(uint32_t i = 0; i < PERF_COUNTERS; i++){
+    if(!_counters->has_counter(i)) continue;
+    file << separator << "\"" << Perf_counters::get_name(i) << "\": " << stats.counters[i];
+    separator = ", ";
+  }
+  file << "}";
+}
+
+/** Profiler::write_trace
+    Write the windows in the Chrome trace-event format (chrome://tracing or
+    Perfetto). Each component is a thread, and in each window it has an event
+    as long as its exclusive time, starting with the window. The windows
+    themselves are events of an additional thread
+
+*/
+void Profiler::write_trace(){
+
+  _trace_file << "{\"traceEvents\": [\n";
+  _trace_file << "  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": {\"name\": \"Frames\"}}";
+
+  for(size_t c = 0; c < _names.size(); c++){
+    _trace_file << ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << c + 1
+                << ", \"args\": {\"name\": \"" << _names[c] << "\"}}";
+  }
+
+  // Timestamps and durations are in microseconds
+  for(auto& window : _windows){
+
+    _trace_file << ",\n  {\"name\": \"frames " << window.first_frame << "-" << window.first_frame + window.frames - 1
+                << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": 0, \"ts\": " << window.start_ns / 1000.0
+                << ", \"dur\": " << window.duration_ns / 1000.0 << "}";
+
+    for(size_t c = 0; c < _names.size(); c++){
+      Component_stats& stats = window.components[c];
+      if(stats.time_ns == 0) continue;
+
+      _trace_file << ",\n  {\"name\": \"" << _names[c] << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << c + 1
+                  << ", \"ts\": " << window.start_ns / 1000.0 << ", \"dur\": " << stats.time_ns / 1000.0
+                  << ", \"args\": {\"calls\": " << stats.calls << ", \"cycles\": " << stats.cycles
+                  << ", \"reads\": " << stats.reads << ", \"writes\": " << stats.writes;
+      write_counters(_trace_file, stats);
+      _trace_file << "}}";
+    }
+  }
+
+  _trace_file << "\n]}\n";
+}
+
+/** Profiler::~Profiler
+    The last window is stored even if incomplete, and the files are written
+
+*/
+Profiler::~Profiler(){
+  if(_window_frames != 0) close_window();
+  write_json();
+  write_trace();
+}
@@ -0,0 +1,108 @@
+#ifndef __PROFILER_H
+#define __PROFILER_H
+
+#include <cstdint>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "perf_counters.h"
+
+// Frames accumulated in each window of the profile
+#define PROFILER_WINDOW_FRAMES 60
+
+// Maximum depth of nested measurements (the CPU accessing the PPU, which is run
+// by the bus before the access, is a measurement nested in the CPU one)
+#define PROFILER_MAX_DEPTH 8
+
+/*
+ * Per-component profiler of the emulation. The bus measures the wall time of
+ * the steps of each object, and counts the reads and writes directed to it.
+ * Nested measurements are subtracted from the outer one, so that the time of
+ * each component is exclusive. The counters are collected in windows of
+ * PROFILER_WINDOW_FRAMES frames, written at the end of the emulation both as
+ * JSON and in the Chrome trace-event format. If hardware counters are given,
+ * they are attributed to the components in the same way as the time.
+ *
+ * The instrumentation of the bus is only compiled with __PROFILER
+ * (cmake -DPROFILER=1), and it is active only if a profiler is provided
+ * to the bus. Otherwise, the macros below are empty.
+ * */
+class Profiler {
+
+  typedef std::chrono::steady_clock clock;
+
+  struct Component_stats {
+    uint64_t calls;
+    uint64_t cycles;
+    uint64_t time_ns;
+    uint64_t reads;
+    uint64_t writes;
+    uint64_t counters[PERF_COUNTERS];
+  };
+
+  struct Window {
+    uint32_t first_frame;
+    uint32_t frames;
+    uint64_t start_ns;
+    uint64_t duration_ns;
+    std::vector<Component_stats> components;
+  };
+
+  struct Measure {
+    uint32_t          component;
+    clock::time_point start;
+    uint64_t          children_ns;
+    Perf_sample       counters;
+    uint64_t          children_counters[PERF_COUNTERS];
+  };
+
+  // Both files are opened at the beginning, and written at the end
+  std::ofstream                _json_file;
+  std::ofstream                _trace_file;
+  std::vector<std::string>     _names;
+  std::vector<Component_stats> _current;
+  std::vector<Window>          _windows;
+  Perf_counters*               _counters;
+
+  // Measurements in progress
+  Measure                      _stack[PROFILER_MAX_DEPTH];
+  uint32_t                     _depth;
+
+  clock::time_point            _start;
+  clock::time_point            _window_start;
+  uint32_t                     _frames;
+  uint32_t                     _window_frames;
+
+  void     close_window();
+  uint64_t elapsed_ns(clock::time_point, clock::time_point);
+  void     write_json();
+  void     write_trace();
+  void     write_counters(std::ofstream&, Component_stats&);
+
+public:
+
+  Profiler(std::string);
+  void add_component(std::string);
+  void set_counters(Perf_counters*);
+  void begin(uint32_t);
+  void end(uint32_t, uint32_t);
+  void count_read(uint32_t component){ _current[component].reads++; }
+  void count_write(uint32_t component){ _current[component].writes++; }
+  void end_frame();
+  ~Profiler();
+};
+
+#ifdef __PROFILER
+#define PROFILER_BEGIN(profiler, component)         if(profiler) (profiler)->begin(component)
+#define PROFILER_END(profiler, calls, cycles)       if(profiler) (profiler)->end(calls, cycles)
+#define PROFILER_COUNT_READ(profiler, component)    if(profiler) (profiler)->count_read(component)
+#define PROFILER_COUNT_WRITE(profiler, component)   if(profiler) (profiler)->count_write(component)
+#else
+#define PROFILER_BEGIN(profiler, component)
+#define PROFILER_END(profiler, calls, cycles)       (void)(calls)
+#define PROFILER_COUNT_READ(profiler, component)
+#define PROFILER_COUNT_WRITE(profiler, component)
+#endif
+
+#endif // __PROFILER_H
@@ -0,0 +1,177 @@
+#include "save_writer.h"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <iostream>
+#include <chrono>
+#include <fcntl.h>
+#include <unistd.h>
+
+/** Save_writer::Save_writer
+    Starts the writer thread. The save file is not written until some content changes
+
+    @param file_name std::string Path of the save file
+    @param data const uint8_t* current content of the RAM, as stored in the save file
+    @param size size_t size of the RAM
+
+*/
+Save_writer::Save_writer(std::string file_name, const uint8_t* data, size_t size){
+
+  _file_name = file_name;
+  _image.assign(data, data + size);
+  _pending = false;
+  _closed = false;
+  _writes = 0;
+  _last_latency_ns = 0;
+  _max_latency_ns = 0;
+
+  _writer = std::thread(&Save_writer::writer_loop, this);
+}
+
+/** Save_writer::update
+    Called by the emulation thread to save the RAM. Only the dirty pages are
+    compared with the image of the save, and their flags are cleared
+
+    @param data const uint8_t* content of the RAM
+    @param dirty_pages std::vector<uint8_t>& one flag per page of SAVE_WRITER_PAGE_SIZE bytes
+    @return bool true if the content changed and a write was scheduled
+
+*/
+bool Save_writer::update(const uint8_t* data, std::vector<uint8_t>& dirty_pages){
+
+  bool   changed = false;
+  size_t offset;
+  size_t length;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  for(size_t page = 0; page < dirty_pages.size(); page++){
+    if(!dirty_pages[page]) continue;
+    dirty_pages[page] = 0;
+
+    offset = page * SAVE_WRITER_PAGE_SIZE;
+    if(offset >= _image.size()) break;
+    length = std::min((size_t) SAVE_WRITER_PAGE_SIZE, _image.size() - offset);
+
+    if(memcmp(&_image[offset], data + offset, length) != 0){
+      memcpy(&_image[offset], data + offset, length);
+      changed = true;
+    }
+  }
+
+  if(changed){
+    _pending = true;
+    _wake.notify_one();
+  }
+
+  return changed;
+}
+
+/** Save_writer::writer_loop
+    Body of the writer thread: writes the last image each time it changes,
+    until the writer is closed and no write is pending
+
+*/
+void Save_writer::writer_loop(){
+
+  std::vector<uint8_t> content;
+
+  while(true){
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this]{ return _closed or _pending; });
+      if(!_pending) return;
+
+      // The emulation keeps updating the image while the copy is written
+      content = _image;
+      _pending = false;
+    }
+
+    write_file(content);
+  }
+}
+
+/** Save_writer::write_file
+    Replace the save file atomically with the given content. The time taken
+    by the successful writes is recorded
+
+    @param content const std::vector<uint8_t>& content of the save
+
+*/
+void Save_writer::write_file(const std::vector<uint8_t>& content){
+
+  std::string temp_name = _file_name + ".tmp";
+  size_t      written = 0;
+  ssize_t     result;
+
+  auto start = std::chrono::steady_clock::now();
+
+  int file = open(temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(file < 0){
+    std::cerr << "Save file " << temp_name << " not opened correctly." << std::endl;
+    return;
+  }
+
+  while(written < content.size()){
+    result = ::write(file, content.data() + written, content.size() - written);
+    if(result <= 0) break;
+    written += result;
+  }
+
+  // The content must be on disk before the rename makes it the save
+  if(written != content.size() or fsync(file) != 0){
+    std::cerr << "Save file " << temp_name << " not written correctly." << std::endl;
+    close(file);
+    unlink(temp_name.c_str());
+    return;
+  }
+  close(file);
+
+  if(rename(temp_name.c_str(), _file_name.c_str()) != 0){
+    std::cerr << "Save file " << _file_name << " not replaced correctly." << std::endl;
+    unlink(temp_name.c_str());
+    return;
+  }
+
+  uint64_t latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  _last_latency_ns.store(latency, std::memory_order_relaxed);
+  if(latency > _max_latency_ns.load(std::memory_order_relaxed)) _max_latency_ns.store(latency, std::memory_order_relaxed);
+  _writes.fetch_add(1, std::memory_order_relaxed);
+}
+
+/** Save_writer::get_writes
+    @return uint32_t number of writes of the save file completed so far
+
+*/
+uint32_t Save_writer::get_writes(){
+  return _writes.load(std::memory_order_relaxed);
+}
+
+/** Save_writer::get_last_latency_ns
+    @return uint64_t duration of the last write of the save file (write, sync and rename)
+
+*/
+uint64_t Save_writer::get_last_latency_ns(){
+  return _last_latency_ns.load(std::memory_order_relaxed);
+}
+
+/** Save_writer::get_max_latency_ns
+    @return uint64_t duration of the slowest write of the save file
+
+*/
+uint64_t Save_writer::get_max_latency_ns(){
+  return _max_latency_ns.load(std::memory_order_relaxed);
+}
+
+/** Save_writer::~Save_writer
+    Waits for the writer thread to complete the pending write
+
+*/
+Save_writer::~Save_writer(){
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _closed = true;
+    _wake.notify_one();
+  }
+  if(_writer.joinable()) _writer.join();
+}
@@ -0,0 +1,56 @@
+#ifndef __SAVE_WRITER_H
+#define __SAVE_WRITER_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/*
+ * Background writer of the save file of a cartridge. The emulation thread
+ * submits the pages of the RAM written since the last save; only the pages
+ * whose content actually changed are copied in the image of the save, and
+ * the file is written only if the image changed. Saves submitted while the
+ * writer is busy are coalesced in the next write.
+ *
+ * The file is written to a temporary file, synchronized to disk and then
+ * renamed over the save, so that a crash never leaves a partial save.
+ * */
+#define SAVE_WRITER_PAGE_SIZE 256
+
+class Save_writer {
+
+  std::string          _file_name;
+
+  // Content of the save as last submitted, protected by the mutex
+  std::vector<uint8_t> _image;
+  bool                 _pending;
+  bool                 _closed;
+
+  std::mutex              _mutex;
+  std::condition_variable _wake;
+  std::thread             _writer;
+
+  // Completed writes and their duration, read by other threads
+  std::atomic<uint32_t>   _writes;
+  std::atomic<uint64_t>   _last_latency_ns;
+  std::atomic<uint64_t>   _max_latency_ns;
+
+  void writer_loop();
+  void write_file(const std::vector<uint8_t>&);
+
+public:
+
+  Save_writer(std::string, const uint8_t*, size_t);
+  bool update(const uint8_t*, std::vector<uint8_t>&);
+  uint32_t get_writes();
+  uint64_t get_last_latency_ns();
+  uint64_t get_max_latency_ns();
+  ~Save_writer();
+};
+
+#endif // __SAVE_WRITER_H
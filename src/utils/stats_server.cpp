@@ -0,0 +1,204 @@
+#include "stats_server.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+/** Stats_server::Stats_server
+    Create the socket and start the server thread. A socket left by a previous
+    run at the same path is replaced, any other file is not
+
+    @param socket_name std::string path of the Unix domain socket
+
+*/
+Stats_server::Stats_server(std::string socket_name){
+
+  struct sockaddr_un address;
+  struct stat        file_info;
+
+  _socket_name = socket_name;
+  _pending_frames = 0;
+  _pending_us.reserve(64);
+  _histogram.assign(STATS_HISTOGRAM_BUCKETS, 0);
+  _frames = 0;
+  _max_frame_us = 0;
+  _state = {0, 0, 0, 0, 0, 0, 0, 0};
+  _closed = false;
+
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(socket_name.size() >= sizeof(address.sun_path))
+    throw std::invalid_argument("Stats socket path " + socket_name + " is too long.");
+  strcpy(address.sun_path, socket_name.c_str());
+
+  if(lstat(socket_name.c_str(), &file_info) == 0){
+    if(!S_ISSOCK(file_info.st_mode))
+      throw std::invalid_argument("Stats socket path " + socket_name + " already exists and it is not a socket.");
+    unlink(socket_name.c_str());
+  }
+
+  _socket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(_socket < 0) throw std::runtime_error("Stats socket not created correctly.");
+
+  if(bind(_socket, (struct sockaddr*) &address, sizeof(address)) != 0 or listen(_socket, 4) != 0){
+    close(_socket);
+    throw std::runtime_error("Stats socket " + socket_name + " not opened correctly.");
+  }
+  fcntl(_socket, F_SETFL, fcntl(_socket, F_GETFL) | O_NONBLOCK);
+
+  _server = std::thread(&Stats_server::server_loop, this);
+}
+
+/** Stats_server::end_frame
+    Called by the emulation thread at the end of each frame
+
+    @param frame const Stats_frame& state of the emulation, and timing of the frame
+
+*/
+void Stats_server::end_frame(const Stats_frame& frame){
+
+  _pending_us.push_back(frame.frame_time_ns / 1000);
+  _pending_frames++;
+
+  // The emulation never waits for the server: if it is reading, the frame is
+  // published with the next one
+  std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+  if(!lock.owns_lock()) return;
+
+  for(uint32_t frame_us : _pending_us){
+    _histogram[std::min(frame_us / STATS_HISTOGRAM_BUCKET_US, (uint32_t) STATS_HISTOGRAM_BUCKETS - 1)]++;
+    _max_frame_us = std::max(_max_frame_us, frame_us);
+  }
+  _frames += _pending_frames;
+  _state = frame;
+
+  _pending_us.clear();
+  _pending_frames = 0;
+}
+
+/** Stats_server::server_loop
+    Body of the server thread: accept the clients, and send them the
+    statistics periodically, until the server is closed
+
+*/
+void Stats_server::server_loop(){
+
+  clock::time_point next_line = clock::now() + std::chrono::milliseconds(STATS_PERIOD_MS);
+
+  while(!_closed){
+
+    struct pollfd listening = {_socket, POLLIN, 0};
+    if(poll(&listening, 1, STATS_POLL_MS) > 0 and (listening.revents & POLLIN)){
+      int client;
+      while((client = accept(_socket, nullptr, nullptr)) >= 0){
+        fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK);
+        _clients.push_back(client);
+      }
+    }
+
+    if(clock::now() < next_line) continue;
+    next_line += std::chrono::milliseconds(STATS_PERIOD_MS);
+
+    // The frame times are reset at each period, even without clients
+    send_line(get_line());
+  }
+}
+
+/** Stats_server::get_percentile
+    Percentile of the frame times, with the resolution of the histogram.
+    Called with the mutex locked
+
+    @param p double percentile, from 0 to 100
+    @return double upper bound of the bucket of the percentile, in milliseconds
+
+*/
+double Stats_server::get_percentile(double p){
+
+  uint64_t total = 0;
+  for(uint32_t count : _histogram) total += count;
+  if(total == 0) return 0;
+
+  uint64_t target = std::max((uint64_t) std::ceil(p / 100 * total), (uint64_t) 1);
+
+  uint64_t cumulative = 0;
+  for(uint32_t i = 0; i < STATS_HISTOGRAM_BUCKETS; i++){
+    cumulative += _histogram[i];
+    if(cumulative >= target) return (i + 1) * STATS_HISTOGRAM_BUCKET_US / 1000.0;
+  }
+  return STATS_HISTOGRAM_BUCKETS * STATS_HISTOGRAM_BUCKET_US / 1000.0;
+}
+
+/** Stats_server::get_line
+    Build the JSON line with the statistics. The percentiles and the maximum
+    of the frame time cover the period since the previous line, the FPS and
+    the speed the last window of the Frame_timer
+
+    @return std::string line, newline included
+
+*/
+std::string Stats_server::get_line(){
+
+  std::ostringstream line;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  line << "{\"frames\": " << _frames
+       << ", \"fps\": " << _state.fps
+       << ", \"speed\": " << _state.speed
+       << ", \"frame_time_ms\": {\"p50\": " << get_percentile(50)
+       << ", \"p95\": " << get_percentile(95)
+       << ", \"p99\": " << get_percentile(99)
+       << ", \"max\": " << _max_frame_us / 1000.0 << "}"
+       << ", \"audio_underruns\": " << _state.audio_underruns
+       << ", \"audio_overruns\": " << _state.audio_overruns
+       << ", \"save_writes\": " << _state.save_writes
+       << ", \"save_latency_ms\": {\"last\": " << _state.save_last_latency_ns / 1e6
+       << ", \"max\": " << _state.save_max_latency_ns / 1e6 << "}}\n";
+
+  // The next line only covers the frames of the next period
+  std::fill(_histogram.begin(), _histogram.end(), 0);
+  _max_frame_us = 0;
+
+  return line.str();
+}
+
+/** Stats_server::send_line
+    Send a line to all the clients. The clients which closed the connection,
+    or which do not read fast enough, are dropped
+
+    @param line std::string line to send
+
+*/
+void Stats_server::send_line(std::string line){
+
+  for(size_t i = 0; i < _clients.size();){
+    ssize_t sent = send(_clients[i], line.data(), line.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+    if(sent == (ssize_t) line.size()){
+      i++;
+      continue;
+    }
+    close(_clients[i]);
+    _clients.erase(_clients.begin() + i);
+  }
+}
+
+/** Stats_server::~Stats_server
+    Stop the server thread, close the connections and remove the socket
+
+*/
+Stats_server::~Stats_server(){
+
+  _closed = true;
+  if(_server.joinable()) _server.join();
+
+  for(int client : _clients) close(client);
+  close(_socket);
+  unlink(_socket_name.c_str());
+}
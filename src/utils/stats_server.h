@@ -0,0 +1,83 @@
+#ifndef __STATS_SERVER_H
+#define __STATS_SERVER_H
+
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Buckets of the frame-time histogram: 0.1 ms each, up to 100 ms. The last
+// bucket also holds the longer frames
+#define STATS_HISTOGRAM_BUCKET_US 100
+#define STATS_HISTOGRAM_BUCKETS   1000
+
+// Interval between two lines sent to the clients
+#define STATS_PERIOD_MS           1000
+
+// Interval at which the server checks for new clients and for the exit
+#define STATS_POLL_MS             100
+
+// State of the emulation at the end of a frame, as known by the emulation thread.
+// The timing comes from the Frame_timer, which owns the wall clock
+struct Stats_frame {
+  uint64_t frame_time_ns;
+  double   fps;
+  double   speed;
+  uint32_t audio_underruns;
+  uint32_t audio_overruns;
+  uint32_t save_writes;
+  uint64_t save_last_latency_ns;
+  uint64_t save_max_latency_ns;
+};
+
+/*
+ * Live statistics of the emulation, served on a Unix domain socket. Each
+ * client connected to the socket receives a JSON line every STATS_PERIOD_MS,
+ * with the percentiles and the maximum of the frame time over that period,
+ * the emulated frames per second, the speed with respect to the real-time
+ * pacing of the emulator (GAMEBOY_PACING_FREQUENCY, 1 at --speed 1), the
+ * audio underruns and the latency of the writes of the save file.
+ *
+ * The emulation thread only passes the frame time and the counters at the
+ * end of each frame, as measured by the Frame_timer. They are published with
+ * a try_lock, so that it never waits for the server thread: if the lock is
+ * busy, the frame times are kept and published at the next frame.
+ * */
+class Stats_server {
+
+  typedef std::chrono::steady_clock clock;
+
+  std::string              _socket_name;
+  int                      _socket;
+  std::vector<int>         _clients;
+
+  // Owned by the emulation thread
+  std::vector<uint32_t>    _pending_us;
+  uint32_t                 _pending_frames;
+
+  // Published by the emulation thread, protected by the mutex
+  std::mutex               _mutex;
+  std::vector<uint32_t>    _histogram;
+  uint64_t                 _frames;
+  uint32_t                 _max_frame_us;
+  Stats_frame              _state;
+
+  std::atomic<bool>        _closed;
+  std::thread              _server;
+
+  void        server_loop();
+  std::string get_line();
+  double      get_percentile(double);
+  void        send_line(std::string);
+
+public:
+
+  Stats_server(std::string);
+  void end_frame(const Stats_frame&);
+  ~Stats_server();
+};
+
+#endif // __STATS_SERVER_H
@@ -0,0 +1,210 @@
+#include "video_capture.h"
+#include <cstring>
+#include <stdexcept>
+
+/** Video_capture::Video_capture
+    Opens the capture file, writes the header and starts the writer thread
+
+    @param file_name std::string Path of the capture file
+    @param width uint16_t Width of the frames
+    @param height uint16_t Height of the frames
+
+*/
+Video_capture::Video_capture(std::string file_name, uint16_t width, uint16_t height) :
+  _queue(VIDEO_CAPTURE_QUEUE_SIZE){
+
+  _width = width;
+  _height = height;
+  _has_pushed = false;
+  _pending_repeats = 0;
+  _frames_since_key = 0;
+
+  _stream.open(file_name, std::ios::binary | std::ios::trunc);
+  if(!_stream.is_open()){
+    throw std::invalid_argument("Capture file " + file_name + " not opened correctly.");
+  }
+
+  _stream.write(VIDEO_CAPTURE_MAGIC, 4);
+  write_u8(VIDEO_CAPTURE_VERSION);
+  write_u16(_width);
+  write_u16(_height);
+  write_u8(VIDEO_CAPTURE_BYTES_PER_PIXEL);
+
+  _last_pushed.resize(_width * _height);
+  _previous.resize(_width * _height);
+  _delta.resize(_width * _height);
+
+  _writer = std::thread(&Video_capture::writer_loop, this);
+}
+
+/** Video_capture::push_frame
+    Called by the emulation thread at the end of each frame. The frame is
+    compared with the previous one: if nothing changed, only a repeat marker
+    is sent to the writer, otherwise the pixels are copied and queued.
+    Frames are never dropped: when VIDEO_CAPTURE_QUEUE_SIZE frames are
+    already waiting, this blocks the emulation until the writer catches up
+
+    @param pixels const uint32_t* content of the screen in RGB888
+
+*/
+void Video_capture::push_frame(const uint32_t* pixels){
+
+  Capture_frame frame;
+  size_t size = _width * _height;
+
+  if(_has_pushed and memcmp(pixels, _last_pushed.data(), size * sizeof(uint32_t)) == 0){
+    frame.repeat = true;
+  }
+  else{
+    frame.repeat = false;
+    frame.pixels.assign(pixels, pixels + size);
+    memcpy(_last_pushed.data(), pixels, size * sizeof(uint32_t));
+    _has_pushed = true;
+  }
+
+  _queue.push(std::move(frame));
+}
+
+/** Video_capture::writer_loop
+    Body of the writer thread: encodes the queued frames until the queue
+    is closed
+
+*/
+void Video_capture::writer_loop(){
+
+  Capture_frame frame;
+
+  while(_queue.pop(frame)){
+    if(frame.repeat) _pending_repeats++;
+    else             write_frame(frame.pixels);
+  }
+
+  write_repeats();
+  _stream.flush();
+}
+
+/** Video_capture::write_frame
+    Encode a frame either as a key frame or as a delta with
+    respect to the previous one
+
+    @param pixels const std::vector<uint32_t>& content of the frame
+
+*/
+void Video_capture::write_frame(const std::vector<uint32_t>& pixels){
+
+  bool key_frame = (_frames_since_key == 0);
+
+  write_repeats();
+
+  if(key_frame){
+    encode_rle(pixels);
+  }
+  else{
+    for(size_t i = 0; i < pixels.size(); i++) _delta[i] = pixels[i] ^ _previous[i];
+    encode_rle(_delta);
+  }
+
+  write_u8(key_frame ? VIDEO_CAPTURE_KEY_FRAME : VIDEO_CAPTURE_DELTA_FRAME);
+  write_u32(_encoded.size());
+  _stream.write((const char*)_encoded.data(), _encoded.size());
+
+  _previous = pixels;
+  _frames_since_key = (_frames_since_key + 1) % VIDEO_CAPTURE_KEY_INTERVAL;
+}
+
+/** Video_capture::write_repeats
+    Store the number of unchanged frames received since the last
+    written frame, if any
+
+*/
+void Video_capture::write_repeats(){
+  if(_pending_repeats == 0) return;
+
+  write_u8(VIDEO_CAPTURE_REPEAT_FRAME);
+  write_u32(_pending_repeats);
+  _pending_repeats = 0;
+}
+
+/** Video_capture::encode_rle
+    Run-length encode the pixels in the `_encoded` buffer
+
+    @param pixels const std::vector<uint32_t>& pixels to encode
+
+*/
+void Video_capture::encode_rle(const std::vector<uint32_t>& pixels){
+
+  size_t i = 0;
+  size_t size = pixels.size();
+
+  auto push_pixel = [this](uint32_t pixel){
+    _encoded.push_back((pixel >> 16) & 0xff);
+    _encoded.push_back((pixel >>  8) & 0xff);
+    _encoded.push_back((pixel >>  0) & 0xff);
+  };
+
+  _encoded.clear();
+
+  while(i < size){
+
+    // Length of the run starting at i
+    size_t run = 1;
+    while(i + run < size and run < VIDEO_CAPTURE_MAX_PACKET and pixels[i + run] == pixels[i]) run++;
+
+    if(run > 1){
+      _encoded.push_back(0x80 + run - 1);
+      push_pixel(pixels[i]);
+      i += run;
+      continue;
+    }
+
+    // Literal packet: stop as soon as two equal pixels are found
+    size_t literal = 1;
+    while(i + literal < size and literal < VIDEO_CAPTURE_MAX_PACKET and
+          !(i + literal + 1 < size and pixels[i + literal] == pixels[i + literal + 1])) literal++;
+
+    _encoded.push_back(literal - 1);
+    for(size_t j = 0; j < literal; j++) push_pixel(pixels[i + j]);
+    i += literal;
+  }
+}
+
+/** Video_capture::write_u8
+    Write a byte in the capture file
+
+    @param data uint8_t byte to write
+
+*/
+void Video_capture::write_u8(uint8_t data){
+  _stream.put(data);
+}
+
+/** Video_capture::write_u16
+    Write a 16-bit integer in the capture file (little-endian)
+
+    @param data uint16_t value to write
+
+*/
+void Video_capture::write_u16(uint16_t data){
+  write_u8(data & 0xff);
+  write_u8(data >> 8);
+}
+
+/** Video_capture::write_u32
+    Write a 32-bit integer in the capture file (little-endian)
+
+    @param data uint32_t value to write
+
+*/
+void Video_capture::write_u32(uint32_t data){
+  write_u16(data & 0xffff);
+  write_u16(data >> 16);
+}
+
+/** Video_capture::~Video_capture
+    Waits for the writer thread to encode all the queued frames
+
+*/
+Video_capture::~Video_capture(){
+  _queue.close();
+  if(_writer.joinable()) _writer.join();
+}
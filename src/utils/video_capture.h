@@ -0,0 +1,77 @@
+#ifndef __VIDEO_CAPTURE_H
+#define __VIDEO_CAPTURE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include "bounded_queue.h"
+
+/*
+ * Capture file format (all the integers are little-endian):
+ *
+ * Header:  "GBVC" | version (u8) | width (u16) | height (u16) | bytes per pixel (u8)
+ *
+ * Then a sequence of records, each starting with a type byte:
+ *  - VIDEO_CAPTURE_KEY_FRAME:    size (u32) | RLE of the pixels
+ *  - VIDEO_CAPTURE_DELTA_FRAME:  size (u32) | RLE of the pixels xor-ed with the previous frame
+ *  - VIDEO_CAPTURE_REPEAT_FRAME: count (u32), the previous frame is shown `count` more times
+ *
+ * RLE works on RGB pixels (3 bytes each). A packet starts with a byte h:
+ *  - h <  0x80: h + 1 literal pixels follow
+ *  - h >= 0x80: the following pixel is repeated h - 0x80 + 1 times
+ * */
+#define VIDEO_CAPTURE_MAGIC           "GBVC"
+#define VIDEO_CAPTURE_VERSION         1
+#define VIDEO_CAPTURE_BYTES_PER_PIXEL 3
+#define VIDEO_CAPTURE_KEY_FRAME       0
+#define VIDEO_CAPTURE_DELTA_FRAME     1
+#define VIDEO_CAPTURE_REPEAT_FRAME    2
+#define VIDEO_CAPTURE_MAX_PACKET      128
+#define VIDEO_CAPTURE_KEY_INTERVAL    600
+#define VIDEO_CAPTURE_QUEUE_SIZE      32
+
+class Video_capture {
+
+  // Frame moved from the emulation thread to the writer thread. Unchanged
+  // frames are sent without pixels
+  struct Capture_frame {
+    bool                  repeat;
+    std::vector<uint32_t> pixels;
+  };
+
+  uint16_t _width;
+  uint16_t _height;
+
+  std::ofstream _stream;
+  std::thread   _writer;
+  Bounded_queue<Capture_frame> _queue;
+
+  // Last frame pushed by the emulation thread, used for deduplication
+  std::vector<uint32_t> _last_pushed;
+  bool                  _has_pushed;
+
+  // Writer thread state
+  std::vector<uint32_t> _previous;
+  std::vector<uint32_t> _delta;
+  std::vector<uint8_t>  _encoded;
+  uint32_t              _pending_repeats;
+  uint32_t              _frames_since_key;
+
+  void writer_loop();
+  void write_frame(const std::vector<uint32_t>&);
+  void write_repeats();
+  void encode_rle(const std::vector<uint32_t>&);
+  void write_u8(uint8_t);
+  void write_u16(uint16_t);
+  void write_u32(uint32_t);
+
+public:
+
+  Video_capture(std::string, uint16_t, uint16_t);
+  void push_frame(const uint32_t*);
+  ~Video_capture();
+};
+
+#endif // __VIDEO_CAPTURE_H